@@ -0,0 +1,520 @@
+#include "batch.h"
+#include "cpu.h"
+#include "disk.h"
+#include "memory.h"
+#include "network.h"
+#include "proc.h"
+#include "ps/ps.h"
+#include "temp.h"
+
+extern struct timespec interval;
+
+static const struct {
+    const char *name;
+    unsigned fields;
+} batch_field_names[] = {
+    {"cpu", BATCH_FIELD_CPU},
+    {"cpus", BATCH_FIELD_CPUS},
+    {"memory", BATCH_FIELD_MEMORY},
+    {"swap", BATCH_FIELD_SWAP},
+    {"network", BATCH_FIELD_NETWORK},
+    {"disk", BATCH_FIELD_DISK},
+    {"temp", BATCH_FIELD_TEMP},
+    {"procs", BATCH_FIELD_PROCS},
+    {"all", BATCH_FIELD_ALL},
+};
+
+static const Batch_Options *batch;
+/** Seconds per update, to turn the network periods into rates. */
+static double batch_seconds;
+
+/** Every record is formatted into this buffer and written with a single
+    `write`, it is sized up front so it only grows if an estimate was off. */
+static char *batch_buffer;
+static size_t batch_size;
+static size_t batch_capacity;
+
+bool
+BatchParseFields(const char *list, unsigned *fields_return) {
+    unsigned fields = 0;
+    while (*list) {
+        const size_t length = strcspn(list, ",");
+        bool found = false;
+        for (size_t i = 0; i < countof(batch_field_names); ++i) {
+            const char *name = batch_field_names[i].name;
+            if (strlen(name) == length && strncmp(name, list, length) == 0) {
+                fields |= batch_field_names[i].fields;
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        list += length;
+        if (*list == ',') {
+            ++list;
+        }
+    }
+    *fields_return = fields;
+    return fields != 0;
+}
+
+bool
+BatchParseFormat(const char *name, int *format_return) {
+    if (strcmp(name, "csv") == 0) {
+        *format_return = BATCH_FORMAT_CSV;
+    } else if (strcmp(name, "json") == 0) {
+        *format_return = BATCH_FORMAT_JSON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool
+BatchHas(unsigned field) {
+    return batch->fields & field;
+}
+
+static void
+BatchReserve(size_t size) {
+    if (batch_size + size <= batch_capacity) {
+        return;
+    }
+    while (batch_size + size > batch_capacity) {
+        batch_capacity *= 2;
+    }
+    batch_buffer = realloc(batch_buffer, batch_capacity);
+}
+
+static void
+BatchPutc(char c) {
+    BatchReserve(1);
+    batch_buffer[batch_size++] = c;
+}
+
+static void
+BatchPuts(const char *s) {
+    const size_t length = strlen(s);
+    BatchReserve(length);
+    memcpy(batch_buffer + batch_size, s, length);
+    batch_size += length;
+}
+
+__attribute__((format(printf, 1, 2))) static void
+BatchPrintf(const char *format, ...) {
+    va_list args;
+    for (;;) {
+        const size_t available = batch_capacity - batch_size;
+        va_start(args, format);
+        const int n
+            = vsnprintf(batch_buffer + batch_size, available, format, args);
+        va_end(args);
+        if ((size_t)n < available) {
+            batch_size += n;
+            return;
+        }
+        BatchReserve(n + 1);
+    }
+}
+
+/** Writes a quoted string, CSV doubles quotes while JSON escapes them along
+    with backslashes and control characters.  CSV has no escapes, control
+    characters become spaces there so every record stays on a single line. */
+static void
+BatchString(const char *s) {
+    BatchPutc('"');
+    for (; *s; ++s) {
+        const unsigned char c = *s;
+        if (batch->format == BATCH_FORMAT_CSV) {
+            if (c == '"') {
+                BatchPutc('"');
+            }
+            BatchPutc(c < 0x20 || c == 0x7f ? ' ' : c);
+        } else if (c == '"' || c == '\\') {
+            BatchPutc('\\');
+            BatchPutc(c);
+        } else if (c < 0x20) {
+            BatchPrintf("\\u%04x", c);
+        } else {
+            BatchPutc(c);
+        }
+    }
+    BatchPutc('"');
+}
+
+/** Writes a percentage, or nothing for CSV and `null` for JSON if it is not
+    known. */
+static void
+BatchPercent(double ratio, bool known) {
+    if (known) {
+        BatchPrintf("%.1f", ratio * 100.0);
+    } else if (batch->format == BATCH_FORMAT_JSON) {
+        BatchPuts("null");
+    }
+}
+
+static void
+BatchDiskUsage(const Disk_FS_Info *fs) {
+    const bool known = fs->ok && fs->total;
+    BatchPercent(known ? (double)fs->used / fs->total : 0.0, known);
+}
+
+static unsigned
+BatchProcCount() {
+    return Min((unsigned)vector_size(ps_get_procs()), batch->top);
+}
+
+static double
+BatchProcCpu(const Proc_Data *proc) {
+    const unsigned long period = ps_cpu_period();
+    return period ? (double)proc->total_cpu_time / period : 0.0;
+}
+
+static double
+BatchProcMemory(const Proc_Data *proc) {
+    const unsigned long total = ps_total_memory();
+    return total ? (double)proc->total_memory / total : 0.0;
+}
+
+static void
+BatchCsvHeader() {
+    BatchPuts("time");
+    if (BatchHas(BATCH_FIELD_CPU)) {
+        BatchPuts(",cpu");
+    }
+    if (BatchHas(BATCH_FIELD_CPUS)) {
+        for (int i = 0; i < CpuCount(); ++i) {
+            BatchPrintf(",cpu%d", i);
+        }
+    }
+    if (BatchHas(BATCH_FIELD_MEMORY)) {
+        BatchPuts(",memory");
+    }
+    if (BatchHas(BATCH_FIELD_SWAP)) {
+        BatchPuts(",swap");
+    }
+    if (BatchHas(BATCH_FIELD_NETWORK)) {
+        BatchPuts(",rx,tx");
+    }
+    if (BatchHas(BATCH_FIELD_DISK)) {
+        for (size_t i = 0; i < DiskCount(); ++i) {
+            BatchPuts(",disk:");
+            BatchPuts(DiskFilesystem(i)->path);
+        }
+    }
+    if (BatchHas(BATCH_FIELD_TEMP)) {
+        for (size_t i = 0; i < TempCount(); ++i) {
+            BatchPuts(",temp:");
+            BatchPuts(TempZoneType(i));
+        }
+    }
+    if (BatchHas(BATCH_FIELD_PROCS)) {
+        for (unsigned i = 1; i <= batch->top; ++i) {
+            BatchPrintf(
+                ",proc%u_pid,proc%u_cpu,proc%u_memory,proc%u_command",
+                i,
+                i,
+                i,
+                i
+            );
+        }
+    }
+    BatchPutc('\n');
+}
+
+static void
+BatchCsvRecord(const struct timespec *now) {
+    BatchPrintf("%ld.%03ld", (long)now->tv_sec, now->tv_nsec / 1000000L);
+    if (BatchHas(BATCH_FIELD_CPU)) {
+        BatchPutc(',');
+        BatchPercent(CpuUsage(-1), true);
+    }
+    if (BatchHas(BATCH_FIELD_CPUS)) {
+        for (int i = 0; i < CpuCount(); ++i) {
+            BatchPutc(',');
+            BatchPercent(CpuUsage(i), true);
+        }
+    }
+    if (BatchHas(BATCH_FIELD_MEMORY)) {
+        BatchPutc(',');
+        BatchPercent(MemoryMainUsage(), true);
+    }
+    if (BatchHas(BATCH_FIELD_SWAP)) {
+        BatchPutc(',');
+        BatchPercent(MemorySwapUsage(), MemorySwapTotal() != 0);
+    }
+    if (BatchHas(BATCH_FIELD_NETWORK)) {
+        unsigned long rx, tx;
+        NetworkLastPeriod(&rx, &tx);
+        BatchPrintf(",%.0f,%.0f", rx / batch_seconds, tx / batch_seconds);
+    }
+    if (BatchHas(BATCH_FIELD_DISK)) {
+        for (size_t i = 0; i < DiskCount(); ++i) {
+            BatchPutc(',');
+            BatchDiskUsage(DiskFilesystem(i));
+        }
+    }
+    if (BatchHas(BATCH_FIELD_TEMP)) {
+        for (size_t i = 0; i < TempCount(); ++i) {
+            BatchPrintf(",%.1f", TempZoneMillidegrees(i) / 1000.0);
+        }
+    }
+    if (BatchHas(BATCH_FIELD_PROCS)) {
+        Proc_Data *const *procs = ps_get_procs();
+        const unsigned count = BatchProcCount();
+        for (unsigned i = 0; i < count; ++i) {
+            BatchPrintf(
+                ",%d,%.1f,%.1f,",
+                (int)procs[i]->pid,
+                BatchProcCpu(procs[i]) * 100.0,
+                BatchProcMemory(procs[i]) * 100.0
+            );
+            BatchString(procs[i]->command_line.str);
+        }
+        // Keep the columns of the header when there are fewer processes.
+        for (unsigned i = count; i < batch->top; ++i) {
+            BatchPuts(",,,,");
+        }
+    }
+    BatchPutc('\n');
+}
+
+static void
+BatchJsonRecord(const struct timespec *now) {
+    BatchPrintf(
+        "{\"time\":%ld.%03ld", (long)now->tv_sec, now->tv_nsec / 1000000L
+    );
+    if (BatchHas(BATCH_FIELD_CPU)) {
+        BatchPuts(",\"cpu\":");
+        BatchPercent(CpuUsage(-1), true);
+    }
+    if (BatchHas(BATCH_FIELD_CPUS)) {
+        BatchPuts(",\"cpus\":[");
+        for (int i = 0; i < CpuCount(); ++i) {
+            if (i) {
+                BatchPutc(',');
+            }
+            BatchPercent(CpuUsage(i), true);
+        }
+        BatchPutc(']');
+    }
+    if (BatchHas(BATCH_FIELD_MEMORY)) {
+        BatchPuts(",\"memory\":");
+        BatchPercent(MemoryMainUsage(), true);
+    }
+    if (BatchHas(BATCH_FIELD_SWAP)) {
+        BatchPuts(",\"swap\":");
+        BatchPercent(MemorySwapUsage(), MemorySwapTotal() != 0);
+    }
+    if (BatchHas(BATCH_FIELD_NETWORK)) {
+        unsigned long rx, tx;
+        NetworkLastPeriod(&rx, &tx);
+        BatchPrintf(
+            ",\"rx\":%.0f,\"tx\":%.0f", rx / batch_seconds, tx / batch_seconds
+        );
+    }
+    if (BatchHas(BATCH_FIELD_DISK)) {
+        BatchPuts(",\"disk\":[");
+        for (size_t i = 0; i < DiskCount(); ++i) {
+            const Disk_FS_Info *fs = DiskFilesystem(i);
+            BatchPuts(i ? ",{\"path\":" : "{\"path\":");
+            BatchString(fs->path);
+            BatchPuts(",\"usage\":");
+            BatchDiskUsage(fs);
+            BatchPutc('}');
+        }
+        BatchPutc(']');
+    }
+    if (BatchHas(BATCH_FIELD_TEMP)) {
+        BatchPuts(",\"temp\":[");
+        for (size_t i = 0; i < TempCount(); ++i) {
+            BatchPuts(i ? ",{\"type\":" : "{\"type\":");
+            BatchString(TempZoneType(i));
+            BatchPrintf(
+                ",\"celsius\":%.1f}", TempZoneMillidegrees(i) / 1000.0
+            );
+        }
+        BatchPutc(']');
+    }
+    if (BatchHas(BATCH_FIELD_PROCS)) {
+        Proc_Data *const *procs = ps_get_procs();
+        const unsigned count = BatchProcCount();
+        BatchPuts(",\"procs\":[");
+        for (unsigned i = 0; i < count; ++i) {
+            BatchPrintf(
+                "%s{\"pid\":%d,\"cpu\":%.1f,\"memory\":%.1f,\"command\":",
+                i ? "," : "",
+                (int)procs[i]->pid,
+                BatchProcCpu(procs[i]) * 100.0,
+                BatchProcMemory(procs[i]) * 100.0
+            );
+            BatchString(procs[i]->command_line.str);
+            BatchPutc('}');
+        }
+        BatchPutc(']');
+    }
+    BatchPuts("}\n");
+}
+
+/** Writes the buffer to stdout, returns false if that failed, most likely
+    because the reading end of a pipe went away. */
+static bool
+BatchFlush() {
+    const char *p = batch_buffer;
+    size_t size = batch_size;
+    batch_size = 0;
+    while (size) {
+        const ssize_t n = write(STDOUT_FILENO, p, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EPIPE) {
+                fprintf(stderr, "sm: write: %s\n", strerror(errno));
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+void
+BatchCollectorInit(unsigned fields) {
+    if (fields & (BATCH_FIELD_CPU | BATCH_FIELD_CPUS)) {
+        CpuCollectorInit();
+    }
+    if (fields & (BATCH_FIELD_MEMORY | BATCH_FIELD_SWAP)) {
+        MemoryCollectorInit();
+    }
+    if (fields & BATCH_FIELD_NETWORK) {
+        NetworkCollectorInit();
+    }
+    if (fields & BATCH_FIELD_DISK) {
+        DiskCollectorInit();
+    }
+    if (fields & BATCH_FIELD_TEMP) {
+        TempCollectorInit();
+    }
+    if (fields & BATCH_FIELD_PROCS) {
+        // The command lines are built with colors for the process list.
+        theme = CreateNamedTheme("default");
+        ps_init();
+        if (proc_kthreads) {
+            ps_toggle_kthreads();
+        }
+    }
+}
+
+void
+BatchCollectorUpdate(unsigned fields) {
+    if (fields & (BATCH_FIELD_CPU | BATCH_FIELD_CPUS)) {
+        CpuUpdate();
+    }
+    if (fields & (BATCH_FIELD_MEMORY | BATCH_FIELD_SWAP)) {
+        MemoryUpdate();
+    }
+    if (fields & BATCH_FIELD_NETWORK) {
+        NetworkUpdate();
+    }
+    if (fields & BATCH_FIELD_DISK) {
+        DiskUpdate();
+    }
+    if (fields & BATCH_FIELD_TEMP) {
+        TempUpdate();
+    }
+    if (fields & BATCH_FIELD_PROCS) {
+        ps_update();
+    }
+}
+
+void
+BatchCollectorQuit(unsigned fields) {
+    if (fields & (BATCH_FIELD_CPU | BATCH_FIELD_CPUS)) {
+        CpuCollectorQuit();
+    }
+    if (fields & (BATCH_FIELD_MEMORY | BATCH_FIELD_SWAP)) {
+        MemoryCollectorQuit();
+    }
+    if (fields & BATCH_FIELD_NETWORK) {
+        NetworkCollectorQuit();
+    }
+    if (fields & BATCH_FIELD_DISK) {
+        DiskCollectorQuit();
+    }
+    if (fields & BATCH_FIELD_TEMP) {
+        TempCollectorQuit();
+    }
+    if (fields & BATCH_FIELD_PROCS) {
+        ps_quit();
+        free(theme);
+        theme = NULL;
+    }
+}
+
+/** Guesses the size of a record so the buffer never has to grow, command
+    lines are the only values that can get long. */
+static size_t
+BatchEstimateSize() {
+    size_t size = 4096;
+    if (BatchHas(BATCH_FIELD_CPUS)) {
+        size += CpuCount() * 16;
+    }
+    if (BatchHas(BATCH_FIELD_DISK)) {
+        for (size_t i = 0; i < DiskCount(); ++i) {
+            size += 32 + strlen(DiskFilesystem(i)->path) * 6;
+        }
+    }
+    if (BatchHas(BATCH_FIELD_TEMP)) {
+        for (size_t i = 0; i < TempCount(); ++i) {
+            size += 32 + strlen(TempZoneType(i)) * 6;
+        }
+    }
+    if (BatchHas(BATCH_FIELD_PROCS)) {
+        size += batch->top * (128 + 512 * 6);
+    }
+    return size;
+}
+
+int
+Batch(const Batch_Options *options) {
+    int status = 0;
+    struct timespec now;
+    batch = options;
+    batch_seconds = interval.tv_sec + interval.tv_nsec / 1e9;
+    if (batch_seconds <= 0.0) {
+        batch_seconds = 1e-9;
+    }
+    // Rates and process usage need a previous sample.
+    BatchCollectorInit(batch->fields);
+    batch_capacity = BatchEstimateSize();
+    batch_buffer = malloc(batch_capacity);
+    batch_size = 0;
+    if (batch->format == BATCH_FORMAT_CSV) {
+        BatchCsvHeader();
+        if (!BatchFlush()) {
+            status = 1;
+        }
+    }
+    for (unsigned long i = 0; !status && (!batch->count || i < batch->count);
+         ++i) {
+        nanosleep(&interval, NULL);
+        BatchCollectorUpdate(batch->fields);
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (batch->format == BATCH_FORMAT_CSV) {
+            BatchCsvRecord(&now);
+        } else {
+            BatchJsonRecord(&now);
+        }
+        if (!BatchFlush()) {
+            status = 1;
+        }
+    }
+    free(batch_buffer);
+    batch_buffer = NULL;
+    BatchCollectorQuit(batch->fields);
+    return status;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "stdafx.h"
+
+#define BATCH_DEFAULT_TOP 10
+
+enum {
+    BATCH_FORMAT_CSV,
+    BATCH_FORMAT_JSON,
+};
+
+enum {
+    BATCH_FIELD_CPU = 1 << 0,
+    BATCH_FIELD_CPUS = 1 << 1,
+    BATCH_FIELD_MEMORY = 1 << 2,
+    BATCH_FIELD_SWAP = 1 << 3,
+    BATCH_FIELD_NETWORK = 1 << 4,
+    BATCH_FIELD_DISK = 1 << 5,
+    BATCH_FIELD_TEMP = 1 << 6,
+    BATCH_FIELD_PROCS = 1 << 7,
+    BATCH_FIELD_ALL = (1 << 8) - 1,
+};
+
+typedef struct {
+    int format;
+    /** Mask of BATCH_FIELD_* values. */
+    unsigned fields;
+    /** Number of processes included, sorted by CPU usage. */
+    unsigned top;
+    /** Number of records to print, 0 to run until killed. */
+    unsigned long count;
+} Batch_Options;
+
+/** Parses a comma separated list of field names into a mask.  Returns false
+    if any name is unknown. */
+bool BatchParseFields(const char *list, unsigned *fields_return);
+
+/** Parses a format name.  Returns false if it is unknown. */
+bool BatchParseFormat(const char *name, int *format_return);
+
+/** Sets up the collectors needed for the given fields without any of the
+    UI. */
+void BatchCollectorInit(unsigned fields);
+void BatchCollectorUpdate(unsigned fields);
+void BatchCollectorQuit(unsigned fields);
+
+/** Prints one record per update interval to stdout without initializing
+    curses.  Returns the exit status. */
+int Batch(const Batch_Options *options);
@@ -1,8 +1,11 @@
 #include "battery.h"
+#include "procfs.h"
 #include "util.h"
 
 IgnoreMouse(Battery);
 IgnoreInput(Battery);
+IgnoreRecord(Battery);
+IgnoreReplay(Battery);
 Widget battery_widget = WIDGET("battery", Battery);
 
 const char *battery_battery = "BAT0";
@@ -19,10 +22,12 @@ static unsigned battery_last_capacity = 0;
 void
 BatteryInit(WINDOW *win) {
     strcpy(battery_capacity, "50");
-    battery_capacity_path
-        = Format("/sys/class/power_supply/%s/capacity", battery_battery);
-    battery_status_path
-        = Format("/sys/class/power_supply/%s/status", battery_battery);
+    battery_capacity_path = Format(
+        "%s/class/power_supply/%s/capacity", sysfs_root, battery_battery
+    );
+    battery_status_path = Format(
+        "%s/class/power_supply/%s/status", sysfs_root, battery_battery
+    );
     BatteryDrawBorder(win);
 }
 
@@ -0,0 +1,551 @@
+#include "bench.h"
+#include "cpu.h"
+#include "disk.h"
+#include "graph.h"
+#include "memory.h"
+#include "network.h"
+#include "offscreen.h"
+#include "profile.h"
+#include "ps/ps.h"
+#include "temp.h"
+#include "util.h"
+#include <sys/ptrace.h>
+
+#define BENCH_CANVAS_WIDTH 100
+#define BENCH_CANVAS_HEIGHT 25
+#define BENCH_GRAPH_SOURCES 4
+#define BENCH_MANY_SOURCES 256
+#define BENCH_CANVAS_SHAPES 64
+#define BENCH_LARGE_CANVAS_WIDTH 400
+#define BENCH_LARGE_CANVAS_HEIGHT 100
+
+typedef struct {
+    const char *name;
+    void (*setup)();
+    void (*run)();
+    void (*teardown)();
+} Bench_Case;
+
+typedef struct {
+    double ns;
+    /** Negative if the allocations are not counted. */
+    double allocations;
+    /** Negative if the system calls could not be counted. */
+    double syscalls;
+} Bench_Result;
+
+/** Defined by the allocator hooks in tools/bench_alloc.c, which are only
+    linked into the `make bench` build, and NULL otherwise. */
+extern bool bench_counting __attribute__((weak));
+extern unsigned long bench_allocations __attribute__((weak));
+
+static Graph bench_graph;
+static Canvas *bench_canvas;
+
+/** Graphs with a single source are filled. */
+static void
+BenchGraphSetup(Graph_Kind kind, size_t sources) {
+    // Fixed seed so runs are comparable.
+    unsigned seed = 1;
+    bench_canvas = CanvasCreateSized(BENCH_CANVAS_WIDTH, BENCH_CANVAS_HEIGHT);
+    GraphConstruct(&bench_graph, kind, sources, DEFAULT_GRAPH_SCALE);
+    GraphSetColors(&bench_graph, 1, 2, 3, 4, -1);
+    GraphSetViewport(
+        &bench_graph,
+        (Rectangle){1, 1, BENCH_CANVAS_WIDTH, BENCH_CANVAS_HEIGHT}
+    );
+    for (size_t i = 0; i < bench_graph.max_samples; ++i) {
+        for (size_t source = 0; source < sources; ++source) {
+            GraphAddSample(
+                &bench_graph, source, (double)rand_r(&seed) / RAND_MAX
+            );
+        }
+    }
+}
+
+static void
+BenchGraphStraightSetup() {
+    BenchGraphSetup(GRAPH_KIND_STRAIGHT, BENCH_GRAPH_SOURCES);
+}
+
+static void
+BenchGraphBezirSetup() {
+    BenchGraphSetup(GRAPH_KIND_BEZIR, BENCH_GRAPH_SOURCES);
+}
+
+static void
+BenchGraphBlocksSetup() {
+    BenchGraphSetup(GRAPH_KIND_BLOCKS, BENCH_GRAPH_SOURCES);
+}
+
+static void
+BenchGraphStraightFillSetup() {
+    BenchGraphSetup(GRAPH_KIND_STRAIGHT, 1);
+}
+
+static void
+BenchGraphBezirFillSetup() {
+    BenchGraphSetup(GRAPH_KIND_BEZIR, 1);
+}
+
+static void
+BenchGraphBlocksFillSetup() {
+    BenchGraphSetup(GRAPH_KIND_BLOCKS, 1);
+}
+
+static void
+BenchGraphStackedSetup() {
+    BenchGraphSetup(GRAPH_KIND_BEZIR, BENCH_GRAPH_SOURCES);
+    GraphSetFill(&bench_graph, GRAPH_FILL_ON);
+}
+
+/** A large machine, drawn as lines and as a heatmap. */
+static void
+BenchGraphManySetup() {
+    BenchGraphSetup(GRAPH_KIND_STRAIGHT, BENCH_MANY_SOURCES);
+}
+
+static void
+BenchGraphHeatmap() {
+    static const short colors[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    GraphDrawHeatmap(
+        &bench_graph, bench_canvas, colors, countof(colors), NULL, NULL
+    );
+}
+
+static void
+BenchGraphDraw() {
+    GraphInvalidate(&bench_graph);
+    GraphDraw(&bench_graph, bench_canvas, NULL, NULL);
+}
+
+static unsigned bench_graph_seed;
+
+static void
+BenchGraphScrollSetup() {
+    BenchGraphSetup(GRAPH_KIND_BEZIR, BENCH_GRAPH_SOURCES);
+    bench_graph_seed = 1;
+    GraphDraw(&bench_graph, bench_canvas, NULL, NULL);
+}
+
+/** The usual case of a single new sample per source between draws. */
+static void
+BenchGraphScroll() {
+    for (size_t source = 0; source < BENCH_GRAPH_SOURCES; ++source) {
+        GraphAddSample(
+            &bench_graph, source, (double)rand_r(&bench_graph_seed) / RAND_MAX
+        );
+    }
+    GraphDraw(&bench_graph, bench_canvas, NULL, NULL);
+}
+
+static void
+BenchGraphTeardown() {
+    GraphDestroy(&bench_graph);
+    CanvasDelete(bench_canvas);
+}
+
+static WINDOW *bench_window;
+
+/** A graph widget on an offscreen terminal of exactly its size. */
+static void
+BenchRenderSetup() {
+    BenchGraphScrollSetup();
+    if (!OffscreenStart(BENCH_CANVAS_WIDTH + 2, BENCH_CANVAS_HEIGHT + 2)) {
+        exit(1);
+    }
+    bench_window = newwin(0, 0, 0, 0);
+}
+
+/** Scrolls the graph and draws it like the CPU widget does, the terminal
+    output goes to /dev/null. */
+static void
+BenchRender() {
+    BenchGraphScroll();
+    CanvasDraw(bench_canvas, bench_window);
+    DrawWindow(bench_window, "CPU");
+    wrefresh(bench_window);
+}
+
+/** Redraws every cell and the whole terminal, as after a resize. */
+static void
+BenchRenderFull() {
+    GraphInvalidate(&bench_graph);
+    GraphDraw(&bench_graph, bench_canvas, NULL, NULL);
+    wclear(bench_window);
+    CanvasDraw(bench_canvas, bench_window);
+    DrawWindow(bench_window, "CPU");
+    wrefresh(bench_window);
+}
+
+static void
+BenchRenderTeardown() {
+    delwin(bench_window);
+    OffscreenStop();
+    BenchGraphTeardown();
+}
+
+/** Random shapes in and slightly around the canvas, as x1, y1, x2, y2. */
+static double bench_shapes[BENCH_CANVAS_SHAPES][4];
+
+/** Lines that cross an edge of the canvas exactly halfway between the first
+    pixel and the one before it, the only place where `CanvasDrawLine` rounds
+    differently than the old line did.  They replace the last of the random
+    shapes. */
+static const double bench_edge_shapes[][4] = {
+    {0, -1, 20, 4},
+    {0, 4, 20, -1},
+    {-1, 0, 4, 20},
+    {4, 0, -1, 20},
+};
+
+static void
+BenchCanvasSetup() {
+    unsigned seed = 1;
+    bench_canvas = CanvasCreateSized(BENCH_CANVAS_WIDTH, BENCH_CANVAS_HEIGHT);
+    for (size_t i = 0; i < BENCH_CANVAS_SHAPES; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            const double size = j % 2 ? BENCH_CANVAS_HEIGHT * 4.0
+                                      : BENCH_CANVAS_WIDTH * 2.0;
+            bench_shapes[i][j]
+                = (double)rand_r(&seed) / RAND_MAX * size * 1.2 - size * 0.1;
+        }
+    }
+    memcpy(
+        bench_shapes[BENCH_CANVAS_SHAPES - countof(bench_edge_shapes)],
+        bench_edge_shapes,
+        sizeof(bench_edge_shapes)
+    );
+}
+
+static void
+BenchCanvasTeardown() {
+    CanvasDelete(bench_canvas);
+}
+
+// The canvas primitives as they were before they were made to work on
+// integers, kept to compare against.
+
+/** Pixels are rounded by `CanvasSet` like `round` does, or with `half_up`
+    halfway cases always round up. */
+static inline void
+BenchOldLineRounded(
+    Canvas *c, double x1_, double y1_, double x2_, double y2_, bool half_up
+) {
+    const int x1 = round(x1_);
+    const int y1 = round(y1_);
+    const int x2 = round(x2_);
+    const int y2 = round(y2_);
+    const int xd = abs(x1 - x2);
+    const int yd = abs(y1 - y2);
+    const int xs = x1 <= x2 ? 1 : -1;
+    const int ys = y1 <= y2 ? 1 : -1;
+    const double r = xd > yd ? xd : yd;
+    for (size_t i = 0; i <= r; ++i) {
+        double x = x1;
+        double y = y1;
+        if (xd != 0) {
+            x += (double)(i * xd) / r * xs;
+        }
+        if (yd != 0) {
+            y += (double)(i * yd) / r * ys;
+        }
+        if (half_up) {
+            x = floor(x + 0.5);
+            y = floor(y + 0.5);
+        }
+        CanvasSet(c, x, y, 1);
+    }
+}
+
+static void
+BenchOldLine(Canvas *c, double x1, double y1, double x2, double y2) {
+    BenchOldLineRounded(c, x1, y1, x2, y2, false);
+}
+
+/** The old line, except that halfway cases round up instead of away from
+    zero, which is what `CanvasDrawLine` does. */
+static void
+BenchReferenceLine(Canvas *c, double x1, double y1, double x2, double y2) {
+    BenchOldLineRounded(c, x1, y1, x2, y2, true);
+}
+
+static void
+BenchOldRect(Canvas *c, double x1_, double y1_, double x2_, double y2_) {
+    const double xs = Max(Min(x1_, x2_), 0.0);
+    const double xe = Min(Max(x1_, x2_), c->width * 2.0 - 1.0);
+    const double ys = Max(Min(y1_, y2_), 0.0);
+    const double ye = Min(Max(y1_, y2_), c->height * 4.0 - 1.0);
+    for (double y = ys; y <= ye; ++y) {
+        for (double x = xs; x <= xe; ++x) {
+            CanvasSet(c, x, y, 1);
+        }
+    }
+}
+
+static void
+BenchCanvasDraw(void (*draw)(Canvas *, double, double, double, double)) {
+    CanvasClear(bench_canvas);
+    for (size_t i = 0; i < BENCH_CANVAS_SHAPES; ++i) {
+        const double *s = bench_shapes[i];
+        draw(bench_canvas, s[0], s[1], s[2], s[3]);
+    }
+}
+
+static void
+BenchLine(Canvas *c, double x1, double y1, double x2, double y2) {
+    CanvasDrawLine(c, x1, y1, x2, y2, 1);
+}
+
+static void
+BenchRect(Canvas *c, double x1, double y1, double x2, double y2) {
+    CanvasDrawRect(c, x1, y1, x2, y2, 1);
+}
+
+static void
+BenchCanvasLine() {
+    BenchCanvasDraw(BenchLine);
+}
+
+static void
+BenchCanvasLineOld() {
+    BenchCanvasDraw(BenchOldLine);
+}
+
+/** Checks that lines are drawn pixel for pixel like the reference. */
+static void
+BenchCanvasLineTeardown() {
+    const size_t size = bench_canvas->stride * bench_canvas->height;
+    uint8_t *expected = malloc(size);
+    BenchCanvasDraw(BenchReferenceLine);
+    memcpy(expected, bench_canvas->chars, size);
+    BenchCanvasDraw(BenchLine);
+    if (memcmp(expected, bench_canvas->chars, size) != 0) {
+        fputs("sm: bench: canvas-line differs from the reference\n", stderr);
+    }
+    free(expected);
+    BenchCanvasTeardown();
+}
+
+static void
+BenchCanvasRect() {
+    BenchCanvasDraw(BenchRect);
+}
+
+static void
+BenchCanvasRectOld() {
+    BenchCanvasDraw(BenchOldRect);
+}
+
+/** A canvas filling a very large terminal. */
+static void
+BenchLargeCanvasSetup() {
+    bench_canvas = CanvasCreateSized(
+        BENCH_LARGE_CANVAS_WIDTH, BENCH_LARGE_CANVAS_HEIGHT
+    );
+}
+
+static void
+BenchCanvasClear() {
+    CanvasClear(bench_canvas);
+}
+
+static void
+BenchCanvasScroll() {
+    CanvasScrollLeft(
+        bench_canvas,
+        0,
+        0,
+        BENCH_LARGE_CANVAS_WIDTH,
+        BENCH_LARGE_CANVAS_HEIGHT,
+        1
+    );
+}
+
+// clang-format off
+static const Bench_Case bench_cases[] = {
+    {"ps-update", ps_init, ps_update, ps_quit},
+    {"cpu-update", CpuCollectorInit, CpuUpdate, CpuCollectorQuit},
+    {"memory-update", MemoryCollectorInit, MemoryUpdate, MemoryCollectorQuit},
+    {"network-update", NetworkCollectorInit, NetworkUpdate, NetworkCollectorQuit},
+    {"disk-update", DiskCollectorInit, DiskUpdate, DiskCollectorQuit},
+    {"temp-update", TempCollectorInit, TempUpdate, TempCollectorQuit},
+    {"graph-straight", BenchGraphStraightSetup, BenchGraphDraw, BenchGraphTeardown},
+    {"graph-bezir", BenchGraphBezirSetup, BenchGraphDraw, BenchGraphTeardown},
+    {"graph-blocks", BenchGraphBlocksSetup, BenchGraphDraw, BenchGraphTeardown},
+    {"graph-straight-fill", BenchGraphStraightFillSetup, BenchGraphDraw, BenchGraphTeardown},
+    {"graph-bezir-fill", BenchGraphBezirFillSetup, BenchGraphDraw, BenchGraphTeardown},
+    {"graph-blocks-fill", BenchGraphBlocksFillSetup, BenchGraphDraw, BenchGraphTeardown},
+    {"graph-stacked", BenchGraphStackedSetup, BenchGraphDraw, BenchGraphTeardown},
+    {"graph-many", BenchGraphManySetup, BenchGraphDraw, BenchGraphTeardown},
+    {"graph-heatmap", BenchGraphManySetup, BenchGraphHeatmap, BenchGraphTeardown},
+    {"graph-scroll", BenchGraphScrollSetup, BenchGraphScroll, BenchGraphTeardown},
+    {"render-graph", BenchRenderSetup, BenchRender, BenchRenderTeardown},
+    {"render-full", BenchRenderSetup, BenchRenderFull, BenchRenderTeardown},
+    {"canvas-line", BenchCanvasSetup, BenchCanvasLine, BenchCanvasLineTeardown},
+    {"canvas-line-old", BenchCanvasSetup, BenchCanvasLineOld, BenchCanvasTeardown},
+    {"canvas-rect", BenchCanvasSetup, BenchCanvasRect, BenchCanvasTeardown},
+    {"canvas-rect-old", BenchCanvasSetup, BenchCanvasRectOld, BenchCanvasTeardown},
+    {"canvas-clear", BenchLargeCanvasSetup, BenchCanvasClear, BenchCanvasTeardown},
+    {"canvas-scroll", BenchLargeCanvasSetup, BenchCanvasScroll, BenchCanvasTeardown},
+};
+// clang-format on
+
+static void
+BenchRun(const Bench_Case *c, unsigned long iterations) {
+    for (unsigned long i = 0; i < iterations; ++i) {
+        c->run();
+    }
+}
+
+/** Runs the benchmark in a traced child process and returns the number of
+    system calls it made, or -1 if it could not be traced.  The child stops
+    itself before and after the measured loop so only the loop gets counted,
+    plus a constant overhead from `raise` that the caller subtracts. */
+static long
+BenchCountSyscalls(const Bench_Case *c, unsigned long iterations) {
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0) {
+            _exit(1);
+        }
+        raise(SIGSTOP);
+        BenchRun(c, iterations);
+        raise(SIGSTOP);
+        _exit(0);
+    }
+    int status;
+    long count = -1;
+    if (waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) {
+        goto done;
+    }
+    ptrace(
+        PTRACE_SETOPTIONS,
+        pid,
+        NULL,
+        (void *)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL)
+    );
+    // Every system call stops the child twice, on entry and on exit.
+    long stops = 0;
+    int deliver = 0;
+    for (;;) {
+        if (ptrace(PTRACE_SYSCALL, pid, NULL, (void *)(long)deliver) != 0
+            || waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) {
+            goto done;
+        }
+        deliver = 0;
+        const int sig = WSTOPSIG(status);
+        if (sig == (SIGTRAP | 0x80)) {
+            ++stops;
+        } else if (sig == SIGSTOP) {
+            break;
+        } else {
+            deliver = sig;
+        }
+    }
+    count = (stops + 1) / 2;
+done:
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return count;
+}
+
+static Bench_Result
+BenchMeasure(const Bench_Case *c, unsigned long iterations) {
+    Bench_Result result;
+    c->setup();
+    // Warm up so one-time work like filling caches is not measured.
+    c->run();
+
+    const bool count_allocations = &bench_allocations != NULL;
+    if (count_allocations) {
+        bench_allocations = 0;
+        bench_counting = true;
+    }
+    const uint64_t start = ProfileNow();
+    BenchRun(c, iterations);
+    const uint64_t end = ProfileNow();
+    result.ns = (double)(end - start) / iterations;
+    if (count_allocations) {
+        bench_counting = false;
+        result.allocations = (double)bench_allocations / iterations;
+    } else {
+        result.allocations = -1.0;
+    }
+
+    // Tracing makes every system call very slow so it uses fewer iterations.
+    const unsigned long traced = Min(iterations, 20UL);
+    const long base = BenchCountSyscalls(c, 0);
+    const long total = BenchCountSyscalls(c, traced);
+    if (base < 0 || total < 0) {
+        result.syscalls = -1.0;
+    } else {
+        result.syscalls = (double)(total - base) / traced;
+    }
+
+    c->teardown();
+    return result;
+}
+
+static bool
+BenchSelected(const char *name, char *const *filters, int filter_count) {
+    if (filter_count == 0) {
+        return true;
+    }
+    for (int i = 0; i < filter_count; ++i) {
+        if (strstr(name, filters[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int
+Bench(unsigned long iterations, char *const *filters, int filter_count) {
+    if (iterations == 0) {
+        fputs("sm: bench: iteration count must be positive\n", stderr);
+        return 1;
+    }
+    bool any = false;
+    for (size_t i = 0; i < countof(bench_cases); ++i) {
+        any |= BenchSelected(bench_cases[i].name, filters, filter_count);
+    }
+    if (!any) {
+        fputs("sm: bench: no benchmark matches the given names\n", stderr);
+        return 1;
+    }
+    // Process command lines get colored while they are read, the pairs are
+    // never initialized since curses isn't running but the theme must exist.
+    theme = CreateNamedTheme("default");
+    printf(
+        "%-20s %12s %12s %12s\n",
+        "benchmark",
+        "ns/op",
+        "syscalls/op",
+        "allocs/op"
+    );
+    for (size_t i = 0; i < countof(bench_cases); ++i) {
+        const Bench_Case *c = &bench_cases[i];
+        if (!BenchSelected(c->name, filters, filter_count)) {
+            continue;
+        }
+        const Bench_Result r = BenchMeasure(c, iterations);
+        printf("%-20s %12.0f ", c->name, r.ns);
+        if (r.syscalls < 0.0) {
+            printf("%12s ", "-");
+        } else {
+            printf("%12.1f ", r.syscalls);
+        }
+        if (r.allocations < 0.0) {
+            printf("%12s\n", "-");
+        } else {
+            printf("%12.1f\n", r.allocations);
+        }
+    }
+    free(theme);
+    return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "stdafx.h"
+
+#define BENCH_DEFAULT_ITERATIONS 200
+
+/** Runs the collector and graph drawing benchmarks without initializing curses
+    on the terminal, the render ones draw onto an offscreen one, and prints the
+    results to stdout.  If any filters are given only benchmarks
+    whose name contains one of them are run.  Returns the exit status. */
+int Bench(unsigned long iterations, char *const *filters, int filter_count);
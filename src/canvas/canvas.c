@@ -1,12 +1,17 @@
+/* For the wide character functions of <ncurses.h> */
+#define NCURSES_WIDECHAR 1
 #include "canvas.h"
 #include <math.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* Apparently this isn't included by <ncurses.h> */
-extern int waddnwstr(WINDOW *win, const wchar_t *wstr, int n);
+#define CANVAS_MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define CANVAS_MIN(a, b) (((a) < (b)) ? (a) : (b))
 
-#define NORMALIZE(x) (size_t) round((double)(x))
+/* Rows start at a multiple of this many cells so operations over whole rows
+   can use aligned vector loads and stores */
+#define CANVAS_ROW_ALIGN 32
 
 static const uint16_t pixel_map[4][2]
     = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
@@ -18,6 +23,8 @@ CanvasCreate(WINDOW *win) {
     Canvas *c = (Canvas *)malloc(sizeof(Canvas));
     c->chars = NULL;
     c->colors = NULL;
+    c->drawn_colors = NULL;
+    c->row_cells = NULL;
     CanvasResize(c, win);
     return c;
 }
@@ -27,6 +34,8 @@ CanvasCreateSized(size_t width, size_t height) {
     Canvas *c = (Canvas *)malloc(sizeof(Canvas));
     c->chars = NULL;
     c->colors = NULL;
+    c->drawn_colors = NULL;
+    c->row_cells = NULL;
     CanvasResizeTo(c, width, height);
     return c;
 }
@@ -35,20 +44,123 @@ void
 CanvasDelete(Canvas *c) {
     free(c->chars);
     free(c->colors);
+    free(c->drawn_colors);
+    free(c->row_cells);
     free(c);
 }
 
 void
 CanvasClear(Canvas *c) {
-    for (size_t i = 0; i < c->width * c->height; ++i) {
-        c->chars[i] = 0;
-        c->colors[i] = 0;
+    memset(c->chars, 0, c->stride * c->height);
+    memset(c->colors, 0, c->stride * c->height * sizeof(short));
+}
+
+void
+CanvasClearRect(Canvas *c, size_t x, size_t y, size_t width, size_t height) {
+    if (x >= c->width || y >= c->height) {
+        return;
+    }
+    width = CANVAS_MIN(width, c->width - x);
+    height = CANVAS_MIN(height, c->height - y);
+    if (x == 0 && width == c->width) {
+        /* Whole rows, the padding between them can be cleared as well */
+        const size_t off = y * c->stride;
+        memset(c->chars + off, 0, height * c->stride);
+        memset(c->colors + off, 0, height * c->stride * sizeof(short));
+        return;
+    }
+    for (size_t row = y; row < y + height; ++row) {
+        memset(c->chars + row * c->stride + x, 0, width);
+        memset(c->colors + row * c->stride + x, 0, width * sizeof(short));
+    }
+}
+
+void
+CanvasFillCells(
+    Canvas *c, size_t x, size_t y, size_t width, size_t height, short color
+) {
+    if (x >= c->width || y >= c->height) {
+        return;
+    }
+    width = CANVAS_MIN(width, c->width - x);
+    height = CANVAS_MIN(height, c->height - y);
+    for (size_t row = y; row < y + height; ++row) {
+        memset(c->chars + row * c->stride + x, 0xff, width);
+        short *colors = c->colors + row * c->stride + x;
+        for (size_t i = 0; i < width; ++i) {
+            colors[i] = color;
+        }
+    }
+}
+
+void
+CanvasScrollLeft(
+    Canvas *c, size_t x, size_t y, size_t width, size_t height, size_t n
+) {
+    if (x >= c->width || y >= c->height) {
+        return;
+    }
+    width = CANVAS_MIN(width, c->width - x);
+    height = CANVAS_MIN(height, c->height - y);
+    if (height == 0) {
+        return;
+    }
+    if (n >= width) {
+        CanvasClearRect(c, x, y, width, height);
+        return;
+    }
+    const size_t keep = width - n;
+    if (x == 0 && width == c->width) {
+        /* Whole rows are moved at once, what ends up in the last `n` cells of
+           each row comes from the padding or the next row and is cleared */
+        const size_t off = y * c->stride;
+        const size_t size = height * c->stride - n;
+        memmove(c->chars + off, c->chars + off + n, size);
+        memmove(c->colors + off, c->colors + off + n, size * sizeof(short));
+    } else {
+        for (size_t row = y; row < y + height; ++row) {
+            const size_t off = row * c->stride + x;
+            memmove(c->chars + off, c->chars + off + n, keep);
+            memmove(
+                c->colors + off, c->colors + off + n, keep * sizeof(short)
+            );
+        }
+    }
+    CanvasClearRect(c, x + keep, y, n, height);
+}
+
+void
+CanvasCopyRect(
+    Canvas *dst,
+    size_t dst_x,
+    size_t dst_y,
+    const Canvas *src,
+    size_t x,
+    size_t y,
+    size_t width,
+    size_t height
+) {
+    if (x >= src->width || y >= src->height || dst_x >= dst->width
+        || dst_y >= dst->height) {
+        return;
+    }
+    width = CANVAS_MIN(width, CANVAS_MIN(src->width - x, dst->width - dst_x));
+    height
+        = CANVAS_MIN(height, CANVAS_MIN(src->height - y, dst->height - dst_y));
+    for (size_t row = 0; row < height; ++row) {
+        const size_t from = (y + row) * src->stride + x;
+        const size_t to = (dst_y + row) * dst->stride + dst_x;
+        memcpy(dst->chars + to, src->chars + from, width);
+        memcpy(dst->colors + to, src->colors + from, width * sizeof(short));
     }
 }
 
 void
 CanvasResize(Canvas *c, WINDOW *win) {
-    CanvasResizeTo(c, getmaxx(win) - 2, getmaxy(win) - 2);
+    /* Windows smaller than their border leave no room at all */
+    CanvasResizeTo(
+        c, CANVAS_MAX(getmaxx(win) - 2, 0), CANVAS_MAX(getmaxy(win) - 2, 0)
+    );
 }
 
 void
@@ -56,158 +168,352 @@ CanvasResizeTo(Canvas *c, size_t width, size_t height) {
     /* No need to preserve old content. */
     free(c->chars);
     free(c->colors);
-    c->chars = calloc(width * height, sizeof(uint8_t));
-    c->colors = malloc(width * height * sizeof(short));
-    for (size_t i = 0; i < width * height; ++i) {
-        c->colors[i] = 0;
-    }
+    free(c->drawn_colors);
+    free(c->row_cells);
+    c->drawn_colors = NULL;
+    c->row_cells = malloc(2 * (width + 1) * sizeof(cchar_t));
+    c->stride = (width + CANVAS_ROW_ALIGN - 1) & ~(CANVAS_ROW_ALIGN - 1);
+    /* Both sizes are multiples of the alignment as aligned_alloc wants */
+    c->chars = aligned_alloc(CANVAS_ROW_ALIGN, c->stride * height);
+    c->colors = aligned_alloc(
+        CANVAS_ROW_ALIGN * sizeof(short), c->stride * height * sizeof(short)
+    );
     c->width = width;
     c->height = height;
+    CanvasClear(c);
 }
 
 void
 CanvasSet(Canvas *c, double x_, double y_, short color) {
-    const int x = NORMALIZE(x_);
-    const int y = NORMALIZE(y_);
-    const int col = x / 2;
-    const int row = y / 4;
-    if (col < 0 || col >= (int)c->width || row < 0 || row >= (int)c->height) {
+    const long x = lround(x_);
+    const long y = lround(y_);
+    if (x < 0 || x >= (long)c->width * 2 || y < 0
+        || y >= (long)c->height * 4) {
         return;
     }
-    const size_t idx = (x / 2) + (y / 4) * c->width;
+    const size_t idx = (x / 2) + (y / 4) * c->stride;
 
     c->chars[idx] |= pixel_map[y % 4][x % 2];
     c->colors[idx] = color;
 }
 
 void
-CanvasDraw(const Canvas *c, WINDOW *win) {
+CanvasDraw(Canvas *c, WINDOW *win) {
     CanvasDrawAt(c, win, 1, 1);
 }
 
+/* Whether a cell has to be written again, either its color changed or the
+   window shows something else there, like text that was drawn over it or
+   a different braille pattern */
+static inline bool
+CanvasCellChanged(const Canvas *c, size_t idx, const cchar_t *shown) {
+    return c->colors[idx] != c->drawn_colors[idx]
+           || shown->chars[0] != (wchar_t)(braille_char_offset + c->chars[idx]);
+}
+
 void
-CanvasDrawAt(const Canvas *c, WINDOW *win, int x0, int y0) {
-    size_t row_off;
+CanvasDrawAt(Canvas *c, WINDOW *win, int x0, int y0) {
+    cchar_t *line = c->row_cells;
+    cchar_t *shown = line + c->width + 1;
     wchar_t ch[] = {0, 0};
-    uint8_t b;
+    attr_t attrs;
+    short pair;
+
+    /* The cells carry the attributes of the window as `wattron` would */
+    wattr_get(win, &attrs, &pair, NULL);
+    attrs &= ~A_COLOR;
+    bool all = c->drawn_colors == NULL || c->drawn_win != win
+               || c->drawn_x != x0 || c->drawn_y != y0
+               || c->drawn_attrs != attrs;
+    if (c->drawn_colors == NULL) {
+        c->drawn_colors = malloc(c->stride * c->height * sizeof(short));
+    }
 
+    /* Changed cells are collected into runs that are copied into the window
+       at once.  Cells of the same color as their left neighbour in a run
+       reuse its cchar_t and only need their character replaced. */
     for (size_t y = 0; y < c->height; ++y) {
-        row_off = y * c->width;
-        wmove(win, y0 + y, x0);
-        for (size_t x = 0; x < c->width; ++x) {
-            b = c->chars[row_off + x];
-            wattron(win, COLOR_PAIR(c->colors[row_off + x]));
-            if (b || 1) {
-                ch[0] = braille_char_offset + c->chars[row_off + x];
-                waddnwstr(win, ch, 1);
-            } else {
-                waddch(win, ' ');
+        const size_t row_off = y * c->stride;
+        const bool all_row
+            = all || mvwin_wchnstr(win, y0 + y, x0, shown, c->width) == ERR;
+        size_t x = 0;
+        while (x < c->width) {
+            if (!all_row && !CanvasCellChanged(c, row_off + x, &shown[x])) {
+                ++x;
+                continue;
             }
-            wattroff(win, COLOR_PAIR(c->colors[row_off + x]));
+            const size_t start = x;
+            do {
+                const size_t idx = row_off + x;
+                if (x > start && c->colors[idx] == c->colors[idx - 1]) {
+                    line[x] = line[x - 1];
+                    line[x].chars[0] = braille_char_offset + c->chars[idx];
+                } else {
+                    ch[0] = braille_char_offset + c->chars[idx];
+                    setcchar(&line[x], ch, attrs, c->colors[idx], NULL);
+                }
+                ++x;
+            } while (x < c->width
+                     && (all_row
+                         || CanvasCellChanged(c, row_off + x, &shown[x])));
+            mvwadd_wchnstr(win, y0 + y, x0 + start, line + start, x - start);
         }
     }
+    memcpy(c->drawn_colors, c->colors, c->stride * c->height * sizeof(short));
+    c->drawn_win = win;
+    c->drawn_x = x0;
+    c->drawn_y = y0;
+    c->drawn_attrs = attrs;
+}
+
+/* Round a coordinate to the nearest pixel, halfway cases away from zero like
+   `round` but without leaving the integers for the rest of the primitive. */
+static inline long
+CanvasPixel(double v) {
+    return lround(v);
+}
+
+static inline long
+CanvasCeilDiv(long a, long b) {
+    /* b > 0 */
+    return a >= 0 ? (a + b - 1) / b : -((-a) / b);
 }
 
+/* Set a pixel that is known to be within the canvas */
+static inline void
+CanvasPlot(Canvas *c, long x, long y, short color) {
+    const size_t idx = (size_t)(y >> 2) * c->stride + (size_t)(x >> 1);
+    c->chars[idx] |= pixel_map[y & 3][x & 1];
+    c->colors[idx] = color;
+}
+
+/* Walk the pixels of a line, calling `plot` on those inside the canvas.  The
+   steps along the major axis that stay inside are found up front, the minor
+   axis uses the error term of a DDA that rounds to the nearest pixel:
+     minor(i) = floor((2 * i * d_minor + r - b) / (2 * r))
+   so no pixel needs to be checked individually.  `b` is 1 when the minor
+   axis goes down so halfway cases round up either way.  That is what `round`
+   does on the canvas, but a point halfway between the first pixel and the one
+   before it is drawn while `round` rounds it away from zero, off the canvas.
+   Rounding the same way everywhere keeps lines the same when moved by whole
+   pixels, which scrolling relies on. */
+#define CANVAS_LINE(c, x1, y1, x2, y2, plot)                                  \
+    do {                                                                      \
+        const long xd_ = labs((x2) - (x1));                                   \
+        const long yd_ = labs((y2) - (y1));                                   \
+        const long xs_ = (x1) <= (x2) ? 1 : -1;                               \
+        const long ys_ = (y1) <= (y2) ? 1 : -1;                               \
+        const bool steep_ = yd_ > xd_;                                        \
+        const long r_ = steep_ ? yd_ : xd_;                                   \
+        const long md_ = steep_ ? xd_ : yd_;                                  \
+        /* Start, step and limit of both axes as (major, minor). */           \
+        const long u0_ = steep_ ? (y1) : (x1), us_ = steep_ ? ys_ : xs_;      \
+        const long v0_ = steep_ ? (x1) : (y1), vs_ = steep_ ? xs_ : ys_;      \
+        const long umax_ = steep_ ? (long)(c)->height * 4 - 1                 \
+                                  : (long)(c)->width * 2 - 1;                 \
+        const long vmax_ = steep_ ? (long)(c)->width * 2 - 1                  \
+                                  : (long)(c)->height * 4 - 1;                \
+        long lo_ = 0, hi_ = r_;                                               \
+        /* Major axis: u0 + i * us within [0, umax]. */                       \
+        if (us_ > 0) {                                                        \
+            lo_ = CANVAS_MAX(lo_, -u0_);                                      \
+            hi_ = CANVAS_MIN(hi_, umax_ - u0_);                               \
+        } else {                                                              \
+            lo_ = CANVAS_MAX(lo_, u0_ - umax_);                               \
+            hi_ = CANVAS_MIN(hi_, u0_);                                       \
+        }                                                                     \
+        /* Minor axis: v0 + minor(i) * vs within [0, vmax], minor(i) is  */   \
+        /* at least k from i >= ceil(((2k - 1) r + b) / 2md) and at most */   \
+        /* k up to i <= ceil(((2k + 1) r + b) / 2md) - 1.                */   \
+        const long b_ = md_ > 0 && vs_ < 0;                                   \
+        if (md_ > 0) {                                                        \
+            const long below_ = vs_ > 0 ? -v0_ : v0_ - vmax_;                 \
+            const long above_ = vs_ > 0 ? vmax_ - v0_ : v0_;                  \
+            if (below_ > 0) {                                                 \
+                lo_ = CANVAS_MAX(                                             \
+                    lo_, CanvasCeilDiv((2 * below_ - 1) * r_ + b_, 2 * md_)   \
+                );                                                            \
+            }                                                                 \
+            if (above_ < 0) {                                                 \
+                hi_ = -1;                                                     \
+            } else if (above_ < md_) {                                        \
+                const long k_ = (2 * above_ + 1) * r_ + b_;                   \
+                hi_ = CANVAS_MIN(hi_, CanvasCeilDiv(k_, 2 * md_) - 1);        \
+            }                                                                 \
+        } else if (v0_ < 0 || v0_ > vmax_) {                                  \
+            hi_ = -1;                                                         \
+        }                                                                     \
+        if (lo_ > hi_) {                                                      \
+            break;                                                            \
+        }                                                                     \
+        const long twice_r_ = 2 * (r_ ? r_ : 1);                              \
+        long e_ = 2 * lo_ * md_ + r_ - b_;                                    \
+        long v_ = v0_ + e_ / twice_r_ * vs_;                                  \
+        e_ %= twice_r_;                                                       \
+        long u_ = u0_ + lo_ * us_;                                            \
+        for (long i_ = lo_; i_ <= hi_; ++i_) {                                \
+            if (steep_) {                                                     \
+                plot(c, v_, u_);                                              \
+            } else {                                                          \
+                plot(c, u_, v_);                                              \
+            }                                                                 \
+            u_ += us_;                                                        \
+            e_ += 2 * md_;                                                    \
+            if (e_ >= twice_r_) {                                             \
+                e_ -= twice_r_;                                               \
+                v_ += vs_;                                                    \
+            }                                                                 \
+        }                                                                     \
+    } while (0)
+
 void
 CanvasDrawLine(
     Canvas *c, double x1_, double y1_, double x2_, double y2_, short color
 ) {
-    const int x1 = NORMALIZE(x1_);
-    const int y1 = NORMALIZE(y1_);
-    const int x2 = NORMALIZE(x2_);
-    const int y2 = NORMALIZE(y2_);
-
-    const int xd = abs(x1 - x2);
-    const int yd = abs(y1 - y2);
-    const int xs = x1 <= x2 ? 1 : -1;
-    const int ys = y1 <= y2 ? 1 : -1;
-
-    const double r = xd > yd ? xd : yd;
-
-    double x, y;
-    for (size_t i = 0; i <= r; ++i) {
-        x = (double)x1;
-        y = (double)y1;
-
-        if (xd != 0) {
-            x += (double)(i * xd) / r * xs;
-            // Note: this clipping is specialized for the graph drawing so we
-            // only need check the X coordinate.
-            if (x < 0) {
-                continue;
-            }
+    const long x1 = CanvasPixel(x1_);
+    const long y1 = CanvasPixel(y1_);
+    const long x2 = CanvasPixel(x2_);
+    const long y2 = CanvasPixel(y2_);
+#define PLOT(c, x, y) CanvasPlot((c), (x), (y), color)
+    CANVAS_LINE(c, x1, y1, x2, y2, PLOT);
+#undef PLOT
+}
+
+/* Bits of a braille cell for its left and right column */
+static const uint8_t column_bits[2]
+    = {0x01 | 0x02 | 0x04 | 0x40, 0x08 | 0x10 | 0x20 | 0x80};
+
+/* Bits of a braille cell for its rows from the given one to the bottom */
+static const uint8_t rows_below_bits[4]
+    = {0xff, 0xff & ~0x09, 0xc0 | 0x24, 0xc0};
+
+/* Bits of a braille cell for its rows from the top to the given one */
+static const uint8_t rows_above_bits[4] = {0x09, 0x09 | 0x12, 0x3f, 0xff};
+
+void
+CanvasFillColumn(Canvas *c, long x, long y1, long y2, short color) {
+    if (x < 0 || x >= (long)c->width * 2) {
+        return;
+    }
+    y1 = CANVAS_MAX(y1, 0);
+    y2 = CANVAS_MIN(y2, (long)c->height * 4 - 1);
+    if (y1 > y2) {
+        return;
+    }
+    const uint8_t column = column_bits[x & 1];
+    const long last = y2 >> 2;
+    size_t idx = (size_t)(y1 >> 2) * c->stride + (size_t)(x >> 1);
+    for (long row = y1 >> 2; row <= last; ++row, idx += c->stride) {
+        uint8_t bits = column;
+        if (row == y1 >> 2) {
+            bits &= rows_below_bits[y1 & 3];
         }
-        if (yd != 0) {
-            y += (double)(i * yd) / r * ys;
+        if (row == last) {
+            bits &= rows_above_bits[y2 & 3];
         }
-
-        CanvasSet(c, x, y, color);
+        c->chars[idx] |= bits;
+        c->colors[idx] = color;
     }
 }
 
-#define CANVAS_MAX(a, b) (((a) > (b)) ? (a) : (b))
-#define CANVAS_MIN(a, b) (((a) < (b)) ? (a) : (b))
+/* Bits of the rows of a braille cell from pixel row `y1` to `y2` */
+static inline uint8_t
+CanvasRowBits(long row, long y1, long y2) {
+    if (row < y1 >> 2 || row > y2 >> 2) {
+        return 0;
+    }
+    uint8_t bits = 0xff;
+    if (row == y1 >> 2) {
+        bits &= rows_below_bits[y1 & 3];
+    }
+    if (row == y2 >> 2) {
+        bits &= rows_above_bits[y2 & 3];
+    }
+    return bits;
+}
 
 void
-CanvasDrawLineFill(
-    Canvas *c, double x1_, double y1_, double x2_, double y2_, short color
+CanvasFillCellColumn(
+    Canvas *c, long x, long left, long right, long bottom, short color
 ) {
-    const int x1 = NORMALIZE(x1_);
-    const int y1 = NORMALIZE(y1_);
-    const int x2 = NORMALIZE(x2_);
-    const int y2 = NORMALIZE(y2_);
-
-    const int xd = abs(x1 - x2);
-    const int yd = abs(y1 - y2);
-    const int xs = x1 <= x2 ? 1 : -1;
-    const int ys = y1 <= y2 ? 1 : -1;
-
-    const double r = CANVAS_MAX(xd, yd);
-
-    double x, y;
-    for (size_t i = 0; i <= r; ++i) {
-        x = (double)x1;
-        y = (double)y1;
-
-        if (xd != 0) {
-            x += (double)(i * xd) / r * xs;
-            if (x < 0) {
-                continue;
-            }
-        }
-
-        if (yd != 0) {
-            y += (double)(i * yd) / r * ys;
-        }
-
-        for (size_t yy = c->height * 4; yy >= (size_t)y; --yy) {
-            CanvasSet(c, x, yy, color);
-        }
+    if (x < 0 || x >= (long)c->width) {
+        return;
+    }
+    left = CANVAS_MAX(left, 0);
+    right = CANVAS_MAX(right, 0);
+    bottom = CANVAS_MIN(bottom, (long)c->height * 4 - 1);
+    const long top = CANVAS_MIN(left, right);
+    if (top > bottom) {
+        return;
     }
+    size_t idx = (size_t)(top >> 2) * c->stride + (size_t)x;
+    for (long row = top >> 2; row <= bottom >> 2; ++row, idx += c->stride) {
+        c->chars[idx] |= (CanvasRowBits(row, left, bottom) & column_bits[0])
+                         | (CanvasRowBits(row, right, bottom) & column_bits[1]);
+        c->colors[idx] = color;
+    }
+}
+
+void
+CanvasLineTops(
+    const Canvas *c,
+    double x1_,
+    double y1_,
+    double x2_,
+    double y2_,
+    int16_t *tops,
+    size_t n
+) {
+    const long x1 = CanvasPixel(x1_);
+    const long y1 = CanvasPixel(y1_);
+    const long x2 = CanvasPixel(x2_);
+    const long y2 = CanvasPixel(y2_);
+#define TOP(c, x, y)                                                          \
+    do {                                                                      \
+        if ((size_t)(x) < n && (y) < tops[(x)]) {                             \
+            tops[(x)] = (y);                                                  \
+        }                                                                     \
+    } while (0)
+    CANVAS_LINE(c, x1, y1, x2, y2, TOP);
+#undef TOP
 }
 
 void
 CanvasDrawRect(
     Canvas *c, double x1_, double y1_, double x2_, double y2_, short color
 ) {
-    // Like in `CanvasDrawLine` this is specific to the graph drawing where only
-    // the the left x can be negative.
-    if (x1_ < 0.0) {
-        x1_ = 0.0;
-    }
-    const size_t x1 = NORMALIZE(x1_);
-    const size_t y1 = NORMALIZE(y1_);
-    const size_t x2 = NORMALIZE(x2_);
-    const size_t y2 = NORMALIZE(y2_);
-
-    const size_t xs = CANVAS_MAX(CANVAS_MIN(x1, x2), 0);
-    const size_t xe = CANVAS_MIN(CANVAS_MAX(x1, x2), c->width * 2 - 1);
-    const size_t ys = CANVAS_MAX(CANVAS_MIN(y1, y2), 0);
-    const size_t ye = CANVAS_MIN(CANVAS_MAX(y1, y2), c->height * 4 - 1);
-
-    for (size_t y = ys; y <= ye; ++y) {
-        for (size_t x = xs; x <= xe; ++x) {
-            CanvasSet(c, x, y, color);
+    const long x1 = CanvasPixel(x1_);
+    const long y1 = CanvasPixel(y1_);
+    const long x2 = CanvasPixel(x2_);
+    const long y2 = CanvasPixel(y2_);
+    const long xs = CANVAS_MAX(CANVAS_MIN(x1, x2), 0);
+    const long xe = CANVAS_MIN(CANVAS_MAX(x1, x2), (long)c->width * 2 - 1);
+    const long ys = CANVAS_MAX(CANVAS_MIN(y1, y2), 0);
+    const long ye = CANVAS_MIN(CANVAS_MAX(y1, y2), (long)c->height * 4 - 1);
+    if (xs > xe || ys > ye) {
+        return;
+    }
+    /* Whole cells at once, only the edges need partial masks. */
+    for (long row = ys >> 2; row <= ye >> 2; ++row) {
+        uint8_t rows = 0xff;
+        if (row == ys >> 2) {
+            rows &= rows_below_bits[ys & 3];
+        }
+        if (row == ye >> 2) {
+            rows &= rows_above_bits[ye & 3];
+        }
+        uint8_t *chars = c->chars + row * c->stride;
+        short *colors = c->colors + row * c->stride;
+        for (long col = xs >> 1; col <= xe >> 1; ++col) {
+            uint8_t bits = rows;
+            if (col == xs >> 1 && (xs & 1)) {
+                bits &= column_bits[1];
+            }
+            if (col == xe >> 1 && !(xe & 1)) {
+                bits &= column_bits[0];
+            }
+            chars[col] |= bits;
+            colors[col] = color;
         }
     }
 }
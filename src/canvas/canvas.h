@@ -8,6 +8,19 @@ typedef struct Canvas {
     short *colors;
     size_t width;
     size_t height;
+    /* Cells from the start of one row to the next in `chars` and `colors`,
+       at least `width` */
+    size_t stride;
+    /* Colors of the cells as last written by CanvasDrawAt and where they
+       were written to, NULL until the first draw */
+    short *drawn_colors;
+    WINDOW *drawn_win;
+    int drawn_x;
+    int drawn_y;
+    attr_t drawn_attrs;
+    /* Two rows of `width + 1` cchar_t used by CanvasDrawAt, which needs the
+       wide character part of <ncurses.h> that includers may not enable */
+    void *row_cells;
 } Canvas;
 
 Canvas *CanvasCreate(WINDOW *win);
@@ -15,22 +28,72 @@ Canvas *CanvasCreateSized(size_t width, size_t height);
 void CanvasDelete(Canvas *c);
 
 void CanvasClear(Canvas *c);
+
+/* Clear the cells in the given rectangle, clipped to the canvas */
+void CanvasClearRect(
+    Canvas *c, size_t x, size_t y, size_t width, size_t height
+);
+
+/* Set every pixel of the cells in the given rectangle, clipped to the
+   canvas */
+void CanvasFillCells(
+    Canvas *c, size_t x, size_t y, size_t width, size_t height, short color
+);
+
+/* Move the cells in the given rectangle `n` cells to the left, clearing the
+   ones that are uncovered on the right */
+void CanvasScrollLeft(
+    Canvas *c, size_t x, size_t y, size_t width, size_t height, size_t n
+);
+
+/* Copy a rectangle of cells from `src` to `dst`, clipped to both */
+void CanvasCopyRect(
+    Canvas *dst,
+    size_t dst_x,
+    size_t dst_y,
+    const Canvas *src,
+    size_t x,
+    size_t y,
+    size_t width,
+    size_t height
+);
 void CanvasResize(Canvas *c, WINDOW *win);
 void CanvasResizeTo(Canvas *c, size_t width, size_t height);
 
 void CanvasSet(Canvas *c, double x_, double y_, short color);
 
-void CanvasDraw(const Canvas *c, WINDOW *win);
+void CanvasDraw(Canvas *c, WINDOW *win);
 
-void CanvasDrawAt(const Canvas *c, WINDOW *win, int x, int y);
+/* Write the canvas to the window, only the cells that differ from what was
+   written the last time are touched */
+void CanvasDrawAt(Canvas *c, WINDOW *win, int x, int y);
 
 void CanvasDrawLine(
     Canvas *c, double x1_, double y1_, double x2_, double y2_, short color
 );
 
-/* Draw a line and fill the space below it */
-void CanvasDrawLineFill(
-    Canvas *c, double x1_, double y1_, double x2_, double y2_, short color
+/* Fill the pixels of column `x` from `y1` down to `y2`, clipped to the
+   canvas */
+void CanvasFillColumn(Canvas *c, long x, long y1, long y2, short color);
+
+/* Fill both pixel columns of the cells in column `x` down to `bottom`, the
+   left one from `left` and the right one from `right`, clipped to the
+   canvas */
+void CanvasFillCellColumn(
+    Canvas *c, long x, long left, long right, long bottom, short color
+);
+
+/* Lower each of the first `n` entries of `tops`, one for every pixel column
+   of the canvas, to the highest pixel the line has in that column.  The line
+   is clipped to the canvas like `CanvasDrawLine` but nothing is drawn. */
+void CanvasLineTops(
+    const Canvas *c,
+    double x1_,
+    double y1_,
+    double x2_,
+    double y2_,
+    int16_t *tops,
+    size_t n
 );
 
 void CanvasDrawRect(
@@ -85,6 +85,7 @@ TryReadConfig(Ini *out, const char **error, int *error_line) {
     FILE *fp = fopen(pathname, "r");
     free(pathname);
     if (!fp) {
+        *error = NULL;
         return false;
     }
     Ini_Options options = INI_OPTIONS_WITH_FLAGS(INI_QUOTED_VALUES);
@@ -117,6 +118,10 @@ ReadConfig() {
     const char *error;
     int error_line;
     if (!TryReadConfig(&config_file, &error, &error_line)) {
+        if (error == NULL) {
+            // No configuration file, everything uses its default.
+            return;
+        }
         fprintf(
             stderr, "Failed to parse config: %s on line %u\n", error, error_line
         );
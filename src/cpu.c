@@ -1,10 +1,59 @@
 #include "cpu.h"
 #include "canvas/canvas.h"
 #include "graph.h"
+#include "procfs.h"
 #include "ps/util.h"
+#include "record.h"
+#include "replay.h"
 #include "theme.h"
 #include "util.h"
 
+/** More CPUs than this are shown as a heatmap by default. */
+#define CPU_HEATMAP_MIN_CPUS 16
+/** Room for a cpu line of the stat file with all of its columns. */
+#define CPU_STAT_LINE_SIZE 256
+
+/** The columns of the cpu lines in the stat file. */
+enum {
+    CPU_JIFFIES_USER,
+    CPU_JIFFIES_NICE,
+    CPU_JIFFIES_SYSTEM,
+    CPU_JIFFIES_IDLE,
+    CPU_JIFFIES_IOWAIT,
+    CPU_JIFFIES_IRQ,
+    CPU_JIFFIES_SOFTIRQ,
+    CPU_JIFFIES_STEAL,
+    /** Guest time is also counted as user and nice time. */
+    CPU_JIFFIES_GUEST,
+    CPU_JIFFIES_GUEST_NICE,
+    CPU_JIFFIES_COUNT,
+};
+
+/** The parts the CPU time is broken down into, stacked in this order.  The
+    rest of the time is idle. */
+enum {
+    /** User and nice time. */
+    CPU_MODE_USER,
+    CPU_MODE_SYSTEM,
+    /** Hard and soft interrupts. */
+    CPU_MODE_IRQ,
+    CPU_MODE_IOWAIT,
+    CPU_MODE_STEAL,
+    CPU_MODE_COUNT,
+};
+
+static const char *const cpu_mode_names[CPU_MODE_COUNT]
+    = {"user", "system", "irq", "iowait", "steal"};
+
+typedef enum {
+    CPU_BREAKDOWN_OFF,
+    /** A stacked graph of the average CPU usage. */
+    CPU_BREAKDOWN_AVERAGE,
+    /** A stacked column with the last period of every CPU. */
+    CPU_BREAKDOWN_CORES,
+    CPU_BREAKDOWN_COUNT,
+} Cpu_Breakdown;
+
 IgnoreMouse(Cpu);
 Widget cpu_widget = WIDGET("cpu", Cpu);
 
@@ -12,27 +61,135 @@ static int cpu_count;
 
 bool cpu_show_avg = false;
 bool cpu_scale_height = false;
+bool cpu_heatmap = false;
 static Canvas *cpu_canvas;
 static short *cpu_colors;
 
-static size_t *cpu_last_total_jiffies;
-static size_t *cpu_last_work_jiffies;
+/** Heatmap colors from idle to busy, for terminals with 256 colors and for
+    ones with only the basic 8. */
+static const short cpu_heat_256[]
+    = {24, 31, 38, 44, 49, 84, 118, 154, 190, 226, 220, 214, 208, 202, 196};
+static const short cpu_heat_8[]
+    = {COLOR_BLUE, COLOR_CYAN, COLOR_GREEN, COLOR_YELLOW, COLOR_RED};
+static short cpu_heat_colors[countof(cpu_heat_256)];
+static size_t cpu_heat_color_count;
+
+static char *cpu_stat_path;
+/** Holds the cpu lines of the stat file, reused by every update. */
+static char *cpu_stat_buf;
+static size_t cpu_stat_size;
+
+/** `CPU_JIFFIES_COUNT` counters for the summary line and every CPU. */
+static uint64_t *cpu_last_jiffies;
+/** The share of every mode in the last period, laid out like
+    `cpu_last_jiffies` with `CPU_MODE_COUNT` values per line. */
+static double *cpu_modes;
 
 static Graph cpu_graph;
 static Graph cpu_avg_graph;
+/** The average share of each mode added to the ones below it. */
+static Graph cpu_modes_graph;
+static Cpu_Breakdown cpu_breakdown = CPU_BREAKDOWN_OFF;
+
+/** Counts the per-CPU lines in the stat file, unlike `get_nprocs_conf` this
+    matches what `CpuUpdate` reads, both for offline CPUs and a custom procfs
+    root. */
+static int
+CpuCountStatLines() {
+    char buf[256];
+    int count = -1;
+    FILE *stat = fopen(cpu_stat_path, "r");
+    if (stat == NULL) {
+        return get_nprocs_conf();
+    }
+    // The first line is the summary, the per-CPU lines immediately follow it.
+    while (fgets(buf, sizeof(buf), stat) && strncmp(buf, "cpu", 3) == 0) {
+        ++count;
+    }
+    fclose(stat);
+    return Max(count, 0);
+}
+
+void
+CpuCollectorInit() {
+    Frame_Reader recorded;
+    cpu_stat_path = Format("%s/stat", procfs_root);
+    if (ReplayActive() && ReplayPeek(RECORD_CPU, &recorded)) {
+        cpu_count = FrameGetVarint(&recorded);
+    } else {
+        cpu_count = CpuCountStatLines();
+    }
+    cpu_stat_size = (cpu_count + 1) * CPU_STAT_LINE_SIZE;
+    cpu_stat_buf = malloc(cpu_stat_size);
+    cpu_last_jiffies
+        = calloc((cpu_count + 1) * CPU_JIFFIES_COUNT, sizeof(uint64_t));
+    cpu_modes = calloc((cpu_count + 1) * CPU_MODE_COUNT, sizeof(double));
+    unsigned graph_scale = DEFAULT_GRAPH_SCALE;
+    Graph_Kind graph_kind = GRAPH_KIND_BEZIR;
+    Graph_Fill graph_fill = GRAPH_FILL_DEFAULT;
+    GetGraphOptions(cpu_widget.name, &graph_kind, &graph_scale, &graph_fill);
+    GraphConstruct(&cpu_graph, graph_kind, cpu_count, graph_scale);
+    GraphSetFill(&cpu_graph, graph_fill);
+    GraphConstruct(&cpu_avg_graph, graph_kind, 1, graph_scale);
+    GraphSetFill(&cpu_avg_graph, graph_fill);
+    GraphConstruct(&cpu_modes_graph, graph_kind, CPU_MODE_COUNT, graph_scale);
+    GraphSetFill(&cpu_modes_graph, GRAPH_FILL_ON);
+    GraphSetFixedRange(&cpu_modes_graph, 0.0, 1.0);
+    // Usage is measured against the previous reading, without one the first
+    // update would show the average since boot.
+    if (!ReplayActive()) {
+        CpuUpdate();
+        GraphClear(&cpu_graph);
+        GraphClear(&cpu_avg_graph);
+        GraphClear(&cpu_modes_graph);
+    }
+}
+
+void
+CpuCollectorQuit() {
+    free(cpu_stat_path);
+    free(cpu_stat_buf);
+    free(cpu_last_jiffies);
+    free(cpu_modes);
+    GraphDestroy(&cpu_graph);
+    GraphDestroy(&cpu_avg_graph);
+    GraphDestroy(&cpu_modes_graph);
+}
+
+int
+CpuCount() {
+    return cpu_count;
+}
+
+double
+CpuUsage(int cpu) {
+    if (cpu < 0) {
+        return GraphLastSample(&cpu_avg_graph, 0);
+    }
+    return GraphLastSample(&cpu_graph, cpu);
+}
 
 void
 CpuInit(WINDOW *win) {
-    cpu_count = get_nprocs_conf();
-    cpu_last_total_jiffies = calloc(cpu_count + 1, sizeof(size_t));
-    cpu_last_work_jiffies = calloc(cpu_count + 1, sizeof(size_t));
+    CpuCollectorInit();
     cpu_show_avg = cpu_show_avg || cpu_count > 8;
+    cpu_heatmap = cpu_heatmap || cpu_count > CPU_HEATMAP_MIN_CPUS;
     CpuDrawBorder(win);
+    WidgetHiddenUpdate(&cpu_widget, HIDDEN_UPDATE_HISTORY);
     cpu_canvas = CanvasCreate(win);
 
+    const bool many_colors = COLORS >= 256;
+    const short *heat = many_colors ? cpu_heat_256 : cpu_heat_8;
+    cpu_heat_color_count
+        = many_colors ? countof(cpu_heat_256) : countof(cpu_heat_8);
+    for (size_t i = 0; i < cpu_heat_color_count; ++i) {
+        cpu_heat_colors[i] = DefColor((ColorDef){heat[i], -1});
+    }
+
     cpu_colors = malloc(sizeof(short) * cpu_count);
     memcpy(cpu_colors, theme->cpu_graphs, sizeof(short) * THEME_CPU_COLORS);
-    const int avail = AvailableColors();
+    // The theme alone can take more pairs than a terminal has colors.
+    const int avail = Max(AvailableColors(), 0);
     if (cpu_count - THEME_CPU_COLORS <= avail) {
         for (int i = THEME_CPU_COLORS; i < cpu_count; i++) {
             cpu_colors[i] = DefColor((ColorDef){16 + rand() % 216, -1});
@@ -52,13 +209,9 @@ CpuInit(WINDOW *win) {
         }
     }
 
-    unsigned graph_scale = DEFAULT_GRAPH_SCALE;
-    Graph_Kind graph_kind = GRAPH_KIND_BEZIR;
-    GetGraphOptions(cpu_widget.name, &graph_kind, &graph_scale);
-    GraphConstruct(&cpu_graph, graph_kind, cpu_count, graph_scale);
     GraphSetColorsList(&cpu_graph, cpu_colors, cpu_count);
-    GraphConstruct(&cpu_avg_graph, graph_kind, 1, graph_scale);
     GraphSetColors(&cpu_avg_graph, theme->cpu_avg, -1);
+    GraphSetColorsList(&cpu_modes_graph, theme->cpu_graphs, CPU_MODE_COUNT);
     if (cpu_show_avg) {
         GraphSetDynamicRange(&cpu_graph, 0.1);
         GraphSetDynamicRange(&cpu_avg_graph, 0.1);
@@ -70,54 +223,180 @@ CpuInit(WINDOW *win) {
 
 void
 CpuQuit() {
-    free(cpu_last_total_jiffies);
-    free(cpu_last_work_jiffies);
+    CpuCollectorQuit();
     CanvasDelete(cpu_canvas);
-    GraphDestroy(&cpu_graph);
-    GraphDestroy(&cpu_avg_graph);
+    free(cpu_colors);
 }
 
-static double
-CpuPollUsage(int id, FILE *stat) {
-    static char buf[10 * 20 + 10 + 8];
-    assert(fgets(buf, sizeof(buf), stat));
-    char *p = buf;
-    skipfields(&p, 1);
-    skipspace(&p);
-
-    const size_t work_jiffies = (str2u(&p) + str2u(&p) + str2u(&p));
-    const size_t total_jiffies
-        = (work_jiffies + str2u(&p) + str2u(&p) + str2u(&p) + str2u(&p)
-           + str2u(&p) + str2u(&p) + str2u(&p));
+/** Reads the start of the stat file, which holds the cpu lines, into
+    `cpu_stat_buf`.  Returns false if nothing could be read. */
+static bool
+CpuReadStat() {
+    const int fd = open(cpu_stat_path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    size_t size = 0;
+    ssize_t n;
+    while (size < cpu_stat_size - 1
+           && (n = read(fd, cpu_stat_buf + size, cpu_stat_size - 1 - size))
+                  > 0) {
+        size += n;
+    }
+    close(fd);
+    cpu_stat_buf[size] = '\0';
+    return size > 0;
+}
 
-    const size_t total_period = total_jiffies - cpu_last_total_jiffies[id];
-    const size_t work_period = work_jiffies - cpu_last_work_jiffies[id];
+/** Parses the cpu line at `*p` and moves it to the next line.  The share of
+    every mode in the period since the last call is written to `cpu_modes`,
+    returns the share of user, nice and system time. */
+static double
+CpuPollUsage(int id, char **p) {
+    uint64_t *last = cpu_last_jiffies + id * CPU_JIFFIES_COUNT;
+    uint64_t period[CPU_JIFFIES_COUNT];
+    skipfields(p, 1);
+    skipspace(p);
+    for (int i = 0; i < CPU_JIFFIES_COUNT; ++i) {
+        // Older kernels have fewer columns, the number after the last one
+        // already moved on to the next line.
+        const uint64_t jiffies = isdigit(**p) ? str2u(p) : last[i];
+        // Some counters, iowait in particular, can go backwards.
+        period[i] = jiffies > last[i] ? jiffies - last[i] : 0;
+        last[i] = jiffies;
+    }
 
-    cpu_last_total_jiffies[id] = total_jiffies;
-    cpu_last_work_jiffies[id] = work_jiffies;
+    // Guest time is already part of the user and nice time.
+    uint64_t total = 0;
+    for (int i = 0; i < CPU_JIFFIES_GUEST; ++i) {
+        total += period[i];
+    }
+    double *modes = cpu_modes + id * CPU_MODE_COUNT;
+    if (total == 0) {
+        // Polled again before a tick passed, nothing new to show.
+        return modes[CPU_MODE_USER] + modes[CPU_MODE_SYSTEM];
+    }
+    const double scale = 1.0 / total;
+    modes[CPU_MODE_USER]
+        = (period[CPU_JIFFIES_USER] + period[CPU_JIFFIES_NICE]) * scale;
+    modes[CPU_MODE_SYSTEM] = period[CPU_JIFFIES_SYSTEM] * scale;
+    modes[CPU_MODE_IRQ]
+        = (period[CPU_JIFFIES_IRQ] + period[CPU_JIFFIES_SOFTIRQ]) * scale;
+    modes[CPU_MODE_IOWAIT] = period[CPU_JIFFIES_IOWAIT] * scale;
+    modes[CPU_MODE_STEAL] = period[CPU_JIFFIES_STEAL] * scale;
+    return modes[CPU_MODE_USER] + modes[CPU_MODE_SYSTEM];
+}
 
-    return (double)work_period / (double)total_period;
+/** Adds the average modes of the last period to the stacked graph. */
+static void
+CpuAddModeSamples() {
+    double sum = 0.0;
+    for (int mode = 0; mode < CPU_MODE_COUNT; ++mode) {
+        sum += cpu_modes[mode];
+        GraphAddSample(&cpu_modes_graph, mode, sum);
+    }
 }
 
 void
 CpuUpdate() {
-    FILE *stat = fopen("/proc/stat", "r");
-    for (int i = 0; i <= cpu_count; ++i) {
-        const double usage = CpuPollUsage(i, stat);
+    if (!CpuReadStat()) {
+        return;
+    }
+    char *p = cpu_stat_buf;
+    for (int i = 0; i <= cpu_count && strncmp(p, "cpu", 3) == 0; ++i) {
+        const double usage = CpuPollUsage(i, &p);
         if (i == 0) {
             GraphAddSample(&cpu_avg_graph, 0, usage);
         } else {
             GraphAddSample(&cpu_graph, i - 1, usage);
         }
     }
-    fclose(stat);
+    CpuAddModeSamples();
+}
+
+/** Labels the first row of every heatmap band with the CPUs it shows. */
+static void
+CpuDrawHeatmapLabels(WINDOW *win) {
+    const int height = cpu_canvas->height;
+    const int groups = Min(cpu_count, height);
+    for (int group = 0; group < groups; ++group) {
+        const int first = group * cpu_count / groups;
+        const int last = (group + 1) * cpu_count / groups - 1;
+        const int y = 1 + group * height / groups;
+        if (first == last) {
+            mvwprintw(win, y, 1, "%d", first);
+        } else {
+            mvwprintw(win, y, 1, "%d-%d", first, last);
+        }
+    }
+}
+
+/** Draws the modes of the last period of every CPU as stacked columns. */
+static void
+CpuDrawCoreModes() {
+    const long width = cpu_canvas->width * 2;
+    const long height = cpu_canvas->height * 4;
+    CanvasClear(cpu_canvas);
+    for (int cpu = 0; cpu < cpu_count; ++cpu) {
+        const long x1 = cpu * width / cpu_count;
+        const long next = (cpu + 1) * width / cpu_count;
+        // Wide enough columns get a gap between them.
+        const long x2 = Max(next - 1 - (next - x1 > 2), x1);
+        const double *modes = cpu_modes + (cpu + 1) * CPU_MODE_COUNT;
+        double sum = 0.0;
+        long bottom = height - 1;
+        for (int mode = 0; mode < CPU_MODE_COUNT && bottom >= 0; ++mode) {
+            sum += modes[mode];
+            const long top = lround((1.0 - Min(sum, 1.0)) * height);
+            for (long x = x1; x <= x2; ++x) {
+                CanvasFillColumn(
+                    cpu_canvas, x, top, bottom, theme->cpu_graphs[mode]
+                );
+            }
+            bottom = Min(bottom, top - 1);
+        }
+    }
+}
+
+/** Prints the average share of every mode, in the colors of the modes. */
+static void
+CpuDrawModeLabels(WINDOW *win) {
+    int x = 3;
+    for (int mode = 0; mode < CPU_MODE_COUNT; ++mode) {
+        const short color = theme->cpu_graphs[mode];
+        wattron(win, COLOR_PAIR(color));
+        mvwprintw(
+            win,
+            2,
+            x,
+            "%s %d%%",
+            cpu_mode_names[mode],
+            (int)(cpu_modes[mode] * 100.f)
+        );
+        wattroff(win, COLOR_PAIR(color));
+        x = getcurx(win) + 2;
+    }
 }
 
 void
 CpuDraw(WINDOW *win) {
     double lo, hi;
-    CanvasClear(cpu_canvas);
-    if (cpu_show_avg) {
+    if (cpu_breakdown == CPU_BREAKDOWN_AVERAGE) {
+        GraphDraw(&cpu_modes_graph, cpu_canvas, &lo, &hi);
+    } else if (cpu_breakdown == CPU_BREAKDOWN_CORES) {
+        CpuDrawCoreModes();
+        lo = 0.0;
+        hi = 1.0;
+    } else if (cpu_heatmap) {
+        GraphDrawHeatmap(
+            &cpu_graph,
+            cpu_canvas,
+            cpu_heat_colors,
+            cpu_heat_color_count,
+            &lo,
+            &hi
+        );
+    } else if (cpu_show_avg) {
         GraphDraw(&cpu_avg_graph, cpu_canvas, &lo, &hi);
     } else {
         GraphDraw(&cpu_graph, cpu_canvas, &lo, &hi);
@@ -126,7 +405,11 @@ CpuDraw(WINDOW *win) {
 
     const int width = getmaxx(win);
     const int height = getmaxy(win);
-    if (cpu_show_avg) {
+    if (cpu_breakdown != CPU_BREAKDOWN_OFF) {
+        CpuDrawModeLabels(win);
+    } else if (cpu_heatmap) {
+        CpuDrawHeatmapLabels(win);
+    } else if (cpu_show_avg) {
         const double u = GraphLastSample(&cpu_avg_graph, 0);
         wattron(win, COLOR_PAIR(theme->cpu_avg));
         mvwprintw(win, 2, 3, "AVRG %d%%", (int)(u * 100.f));
@@ -153,6 +436,7 @@ CpuResize(WINDOW *win) {
     const Rectangle viewport = {1, 1, cpu_canvas->width, cpu_canvas->height};
     GraphSetViewport(&cpu_graph, viewport);
     GraphSetViewport(&cpu_avg_graph, viewport);
+    GraphSetViewport(&cpu_modes_graph, viewport);
 }
 
 void
@@ -177,6 +461,67 @@ CpuDrawBorder(WINDOW *win) {
     DrawWindow(win, "CPU");
 }
 
+void
+CpuRecord(Frame *frame, bool keyframe) {
+    (void)keyframe;
+    const size_t mark = RecordBegin(frame, RECORD_CPU);
+    FramePutVarint(frame, cpu_count);
+    FramePutRatio(frame, GraphLastSample(&cpu_avg_graph, 0));
+    for (int i = 0; i < cpu_count; ++i) {
+        FramePutRatio(frame, GraphLastSample(&cpu_graph, i));
+    }
+    RecordEnd(frame, mark);
+
+    const size_t modes_mark = RecordBegin(frame, RECORD_CPU_MODES);
+    FramePutVarint(frame, cpu_count);
+    for (int i = 0; i < (cpu_count + 1) * CPU_MODE_COUNT; ++i) {
+        FramePutRatio(frame, cpu_modes[i]);
+    }
+    RecordEnd(frame, modes_mark);
+}
+
+void
+CpuReplay(Frame_Reader *reader, int type) {
+    if (type == RECORD_REPLAY_RESET) {
+        GraphClear(&cpu_graph);
+        GraphClear(&cpu_avg_graph);
+        GraphClear(&cpu_modes_graph);
+        memset(cpu_modes, 0, (cpu_count + 1) * CPU_MODE_COUNT * sizeof(double));
+        return;
+    }
+    if (type == RECORD_CPU_MODES) {
+        // Recordings made before the modes were kept have none of these.
+        const int count = FrameGetVarint(reader);
+        for (int i = 0; i < (count + 1) * CPU_MODE_COUNT; ++i) {
+            const double share = FrameGetRatio(reader);
+            if (i < (cpu_count + 1) * CPU_MODE_COUNT) {
+                cpu_modes[i] = share;
+            }
+        }
+        CpuAddModeSamples();
+        return;
+    }
+    if (type != RECORD_CPU) {
+        return;
+    }
+    const int count = FrameGetVarint(reader);
+    GraphAddSample(&cpu_avg_graph, 0, FrameGetRatio(reader));
+    for (int i = 0; i < count; ++i) {
+        const double usage = FrameGetRatio(reader);
+        if (i < cpu_count) {
+            GraphAddSample(&cpu_graph, i, usage);
+        }
+    }
+}
+
+/** All graphs share the canvas, the next one drawn can't reuse it. */
+static void
+CpuInvalidateGraphs() {
+    GraphInvalidate(&cpu_graph);
+    GraphInvalidate(&cpu_avg_graph);
+    GraphInvalidate(&cpu_modes_graph);
+}
+
 bool
 CpuHandleInput(int key) {
     switch (key) {
@@ -193,6 +538,17 @@ CpuHandleInput(int key) {
 
     case 'a':
         cpu_show_avg = !cpu_show_avg;
+        CpuInvalidateGraphs();
+        break;
+
+    case 'h':
+        cpu_heatmap = !cpu_heatmap;
+        CpuInvalidateGraphs();
+        break;
+
+    case 'b':
+        cpu_breakdown = (cpu_breakdown + 1) % CPU_BREAKDOWN_COUNT;
+        CpuInvalidateGraphs();
         break;
 
     default:
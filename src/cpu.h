@@ -4,9 +4,22 @@
 
 extern bool cpu_show_avg;
 extern bool cpu_scale_height;
+/** Whether the CPUs are shown as a heatmap instead of graphs. */
+extern bool cpu_heatmap;
 
 extern Widget cpu_widget;
 
+/** Sets up the data collection without any of the UI, `CpuUpdate` may be
+    called after this. */
+void CpuCollectorInit();
+void CpuCollectorQuit();
+
+/** Returns the number of CPUs. */
+int CpuCount();
+/** Returns the latest usage of a CPU in 0~1, or the average of all CPUs if
+    `cpu` is -1. */
+double CpuUsage(int cpu);
+
 void CpuInit(WINDOW *win);
 void CpuQuit();
 void CpuUpdate();
@@ -15,3 +28,5 @@ void CpuResize(WINDOW *win);
 void CpuMinSize(int *width_return, int *height_return);
 bool CpuHandleInput(int key);
 void CpuDrawBorder(WINDOW *win);
+void CpuRecord(Frame *frame, bool keyframe);
+void CpuReplay(Frame_Reader *reader, int type);
@@ -1,5 +1,7 @@
 #include "disk.h"
 #include "canvas/canvas.h"
+#include "record.h"
+#include "replay.h"
 #include "util.h"
 
 static const double disk_radius = 9.0;
@@ -13,17 +15,10 @@ Widget disk_widget = WIDGET("disk_usage", Disk);
 bool disk_vertical = false;
 const char *disk_fs = NULL;
 
-typedef struct {
-    const char *path;
-    uintmax_t total;
-    uintmax_t avail;
-    uintmax_t used;
-    bool changed;
-    bool ok;
-} Disk_FS_Info;
-
 static Canvas *disk_canvas;
 static List *disk_filesystems;
+/** Filesystem string built from a recording, owned by this module. */
+static char *disk_replay_fs;
 
 static int disk_margin;
 static int disk_padding;
@@ -61,15 +56,89 @@ DiskForceUpdate() {
     }
 }
 
+/** Builds the filesystem string from the paths in the first disk record of
+    the replayed file. */
+static bool
+DiskReplayFsString() {
+    Frame_Reader recorded;
+    if (!ReplayPeek(RECORD_DISK, &recorded)) {
+        return false;
+    }
+    size_t count = FrameGetVarint(&recorded);
+    size_t length = 0;
+    disk_replay_fs = NULL;
+    while (count-- && !recorded.error) {
+        char *path = FrameGetString(&recorded);
+        const size_t path_length = strlen(path);
+        disk_replay_fs = realloc(disk_replay_fs, length + path_length + 2);
+        memcpy(disk_replay_fs + length, path, path_length);
+        length += path_length;
+        disk_replay_fs[length++] = ',';
+        free(path);
+        FrameGetU8(&recorded);
+        FrameGetVarint(&recorded);
+        FrameGetVarint(&recorded);
+        FrameGetVarint(&recorded);
+    }
+    if (length == 0) {
+        free(disk_replay_fs);
+        disk_replay_fs = NULL;
+        return false;
+    }
+    // Replace the trailing comma.
+    disk_replay_fs[length - 1] = '\0';
+    disk_fs = disk_replay_fs;
+    return true;
+}
+
 void
-DiskInit(WINDOW *win) {
-    DiskDrawBorder(win);
-    disk_canvas
-        = CanvasCreateSized(ceil(disk_radius) + 1, ceil(disk_radius / 2));
+DiskCollectorInit() {
+    if (ReplayActive() && DiskReplayFsString()) {
+        DiskParseFsString((char *)disk_fs);
+        return;
+    }
     if (!(disk_fs || (disk_fs = getenv("SM_DISK_FS"))) || !*disk_fs) {
         disk_fs = "/";
     }
     DiskParseFsString((char *)disk_fs);
+}
+
+void
+DiskCollectorQuit() {
+    list_for_each(disk_filesystems, it) {
+        free(it->p);
+    }
+    list_delete(disk_filesystems);
+    disk_filesystems = NULL;
+    free(disk_replay_fs);
+    disk_replay_fs = NULL;
+}
+
+size_t
+DiskCount() {
+    size_t count = 0;
+    list_for_each(disk_filesystems, it) {
+        ++count;
+    }
+    return count;
+}
+
+const Disk_FS_Info *
+DiskFilesystem(size_t n) {
+    list_for_each(disk_filesystems, it) {
+        if (n-- == 0) {
+            return it->p;
+        }
+    }
+    return NULL;
+}
+
+void
+DiskInit(WINDOW *win) {
+    DiskDrawBorder(win);
+    disk_canvas
+        = CanvasCreateSized(ceil(disk_radius) + 1, ceil(disk_radius / 2));
+    DiskCollectorInit();
     if (getenv("SM_DISK_VERTICAL") != NULL) {
         disk_vertical = true;
     }
@@ -81,6 +150,7 @@ DiskInit(WINDOW *win) {
 
 void
 DiskQuit() {
+    DiskCollectorQuit();
     CanvasDelete(disk_canvas);
 }
 
@@ -112,6 +182,59 @@ DiskUpdate() {
     }
 }
 
+void
+DiskRecord(Frame *frame, bool keyframe) {
+    Disk_FS_Info *fs_info;
+    bool changed = keyframe;
+    size_t count = 0;
+    list_for_each(disk_filesystems, it) {
+        fs_info = it->p;
+        changed |= fs_info->changed;
+        ++count;
+    }
+    // Disk usage rarely changes, only record it when it does.
+    if (!changed) {
+        return;
+    }
+    const size_t mark = RecordBegin(frame, RECORD_DISK);
+    FramePutVarint(frame, count);
+    list_for_each(disk_filesystems, it) {
+        fs_info = it->p;
+        FramePutString(frame, fs_info->path);
+        FramePutU8(frame, fs_info->ok);
+        FramePutVarint(frame, fs_info->total);
+        FramePutVarint(frame, fs_info->avail);
+        FramePutVarint(frame, fs_info->used);
+    }
+    RecordEnd(frame, mark);
+}
+
+void
+DiskReplay(Frame_Reader *reader, int type) {
+    if (type != RECORD_DISK) {
+        return;
+    }
+    Disk_FS_Info *fs_info, before;
+    size_t count = FrameGetVarint(reader);
+    // The filesystems were set up from the same record in `DiskCollectorInit`
+    // so they are in the same order.
+    list_for_each(disk_filesystems, it) {
+        if (count-- == 0) {
+            break;
+        }
+        fs_info = it->p;
+        before = *fs_info;
+        free(FrameGetString(reader));
+        fs_info->ok = FrameGetU8(reader);
+        fs_info->total = FrameGetVarint(reader);
+        fs_info->avail = FrameGetVarint(reader);
+        fs_info->used = FrameGetVarint(reader);
+        fs_info->changed
+            = (fs_info->total != before.total || fs_info->avail != before.avail
+               || fs_info->used != before.used);
+    }
+}
+
 static inline void
 DiskDrawArc(
     double x,
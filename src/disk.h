@@ -5,6 +5,25 @@
 extern bool disk_vertical;
 extern const char *disk_fs;
 
+typedef struct {
+    const char *path;
+    uintmax_t total;
+    uintmax_t avail;
+    uintmax_t used;
+    bool changed;
+    bool ok;
+} Disk_FS_Info;
+
+/** Sets up the data collection without any of the UI, `DiskUpdate` may be
+    called after this. */
+void DiskCollectorInit();
+void DiskCollectorQuit();
+
+/** Returns the number of filesystems. */
+size_t DiskCount();
+/** Returns the usage of the n-th filesystem from the last update. */
+const Disk_FS_Info *DiskFilesystem(size_t n);
+
 void DiskInit(WINDOW *win);
 void DiskQuit();
 void DiskUpdate();
@@ -13,5 +32,7 @@ void DiskResize(WINDOW *win);
 void DiskMinSize(int *width_return, int *height_return);
 void DiskPreferredSize(int *width_return, int *height_return);
 void DiskDrawBorder(WINDOW *win);
+void DiskRecord(Frame *frame, bool keyframe);
+void DiskReplay(Frame_Reader *reader, int type);
 
 extern Widget disk_widget;
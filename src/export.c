@@ -0,0 +1,386 @@
+#include "export.h"
+#include "cpu.h"
+#include "disk.h"
+#include "frame.h"
+#include "memory.h"
+#include "network.h"
+#include "ps/ps.h"
+#include "socket.h"
+#include "temp.h"
+#include <sys/socket.h>
+
+extern struct timespec interval;
+
+static const Batch_Options *export_options;
+static int export_fd = -1;
+static volatile sig_atomic_t export_stopping;
+
+/** The metrics of the last update, swapped with `export_back` once the next
+    update is formatted so a scrape never waits for the collectors. */
+static Frame export_front;
+static Frame export_back;
+static pthread_mutex_t export_mutex;
+static pthread_t export_thread;
+
+static void
+ExportStop(int signal) {
+    (void)signal;
+    export_stopping = true;
+}
+
+static bool
+ExportHas(unsigned field) {
+    return export_options->fields & field;
+}
+
+/** Writes a label value, escaping what the text format requires and cutting
+    it at `limit` bytes without splitting a UTF-8 sequence. */
+static void
+ExportLabel(Frame *out, const char *name, const char *value, size_t limit) {
+    size_t length = strlen(value);
+    if (length > limit) {
+        length = limit;
+        while (length && ((unsigned char)value[length] & 0xC0) == 0x80) {
+            --length;
+        }
+    }
+    FramePrintf(out, "%s=\"", name);
+    for (size_t i = 0; i < length; ++i) {
+        switch (value[i]) {
+        case '\\':
+            FramePutBytes(out, "\\\\", 2);
+            break;
+        case '"':
+            FramePutBytes(out, "\\\"", 2);
+            break;
+        case '\n':
+            FramePutBytes(out, "\\n", 2);
+            break;
+        default:
+            FramePutU8(out, value[i]);
+        }
+    }
+    FramePutU8(out, '"');
+}
+
+static void
+ExportFamily(
+    Frame *out, const char *name, const char *type, const char *help
+) {
+    FramePrintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void
+ExportCpu(Frame *out) {
+    if (ExportHas(BATCH_FIELD_CPU)) {
+        ExportFamily(
+            out, "sm_cpu_average_usage_ratio", "gauge", "Average CPU usage."
+        );
+        FramePrintf(out, "sm_cpu_average_usage_ratio %g\n", CpuUsage(-1));
+    }
+    if (ExportHas(BATCH_FIELD_CPUS)) {
+        ExportFamily(out, "sm_cpu_usage_ratio", "gauge", "Usage per CPU.");
+        for (int i = 0; i < CpuCount(); ++i) {
+            FramePrintf(
+                out, "sm_cpu_usage_ratio{cpu=\"%d\"} %g\n", i, CpuUsage(i)
+            );
+        }
+    }
+}
+
+static void
+ExportMemory(Frame *out) {
+    if (ExportHas(BATCH_FIELD_MEMORY)) {
+        ExportFamily(
+            out, "sm_memory_total_bytes", "gauge", "Total main memory."
+        );
+        FramePrintf(out, "sm_memory_total_bytes %lu\n", MemoryMainTotal());
+        ExportFamily(
+            out, "sm_memory_usage_ratio", "gauge", "Main memory in use."
+        );
+        FramePrintf(out, "sm_memory_usage_ratio %g\n", MemoryMainUsage());
+    }
+    if (ExportHas(BATCH_FIELD_SWAP)) {
+        ExportFamily(out, "sm_swap_total_bytes", "gauge", "Total swap.");
+        FramePrintf(out, "sm_swap_total_bytes %lu\n", MemorySwapTotal());
+        ExportFamily(out, "sm_swap_usage_ratio", "gauge", "Swap in use.");
+        // Without swap the usage would be NaN.
+        FramePrintf(
+            out,
+            "sm_swap_usage_ratio %g\n",
+            MemorySwapTotal() ? MemorySwapUsage() : 0.0
+        );
+    }
+}
+
+static void
+ExportNetwork(Frame *out) {
+    unsigned long rx, tx;
+    if (!ExportHas(BATCH_FIELD_NETWORK)) {
+        return;
+    }
+    NetworkTotals(&rx, &tx);
+    ExportFamily(
+        out,
+        "sm_network_receive_bytes_total",
+        "counter",
+        "Bytes received by all interfaces."
+    );
+    FramePrintf(out, "sm_network_receive_bytes_total %lu\n", rx);
+    ExportFamily(
+        out,
+        "sm_network_transmit_bytes_total",
+        "counter",
+        "Bytes transmitted by all interfaces."
+    );
+    FramePrintf(out, "sm_network_transmit_bytes_total %lu\n", tx);
+}
+
+static void
+ExportDisk(Frame *out) {
+    static const struct {
+        const char *name;
+        const char *help;
+        size_t offset;
+    } metrics[] = {
+        {"sm_filesystem_size_bytes",
+         "Size of the filesystem.",
+         offsetof(Disk_FS_Info, total)},
+        {"sm_filesystem_used_bytes",
+         "Used space of the filesystem.",
+         offsetof(Disk_FS_Info, used)},
+        {"sm_filesystem_avail_bytes",
+         "Space available to unprivileged users.",
+         offsetof(Disk_FS_Info, avail)},
+    };
+    if (!ExportHas(BATCH_FIELD_DISK)) {
+        return;
+    }
+    for (size_t m = 0; m < countof(metrics); ++m) {
+        ExportFamily(out, metrics[m].name, "gauge", metrics[m].help);
+        for (size_t i = 0; i < DiskCount(); ++i) {
+            const Disk_FS_Info *fs = DiskFilesystem(i);
+            if (!fs->ok) {
+                continue;
+            }
+            const uintmax_t value
+                = *(const uintmax_t *)((const char *)fs + metrics[m].offset);
+            FramePrintf(out, "%s{", metrics[m].name);
+            ExportLabel(out, "path", fs->path, SIZE_MAX);
+            FramePrintf(out, "} %ju\n", value);
+        }
+    }
+}
+
+static void
+ExportTemp(Frame *out) {
+    if (!ExportHas(BATCH_FIELD_TEMP)) {
+        return;
+    }
+    ExportFamily(
+        out, "sm_thermal_zone_celsius", "gauge", "Temperature of the zone."
+    );
+    for (size_t i = 0; i < TempCount(); ++i) {
+        FramePrintf(out, "sm_thermal_zone_celsius{zone=\"%zu\",", i);
+        ExportLabel(out, "type", TempZoneType(i), SIZE_MAX);
+        FramePrintf(out, "} %g\n", TempZoneMillidegrees(i) / 1000.0);
+    }
+}
+
+static void
+ExportProcs(Frame *out) {
+    static const char *const names[] = {
+        "sm_process_cpu_ratio",
+        "sm_process_memory_ratio",
+    };
+    static const char *const helps[] = {
+        "Share of all CPU time used by the process.",
+        "Share of main memory used by the process.",
+    };
+    if (!ExportHas(BATCH_FIELD_PROCS)) {
+        return;
+    }
+    Proc_Data *const *procs = ps_get_procs();
+    const size_t count = Min(vector_size(procs), (size_t)export_options->top);
+    const unsigned long cpu_period = ps_cpu_period();
+    const unsigned long total_memory = ps_total_memory();
+    for (size_t m = 0; m < countof(names); ++m) {
+        ExportFamily(out, names[m], "gauge", helps[m]);
+        for (size_t i = 0; i < count; ++i) {
+            const unsigned long value
+                = m == 0 ? procs[i]->total_cpu_time : procs[i]->total_memory;
+            const unsigned long total = m == 0 ? cpu_period : total_memory;
+            FramePrintf(out, "%s{pid=\"%d\",", names[m], (int)procs[i]->pid);
+            ExportLabel(
+                out,
+                "command",
+                procs[i]->command_line.str,
+                EXPORT_COMMAND_LENGTH
+            );
+            FramePrintf(out, "} %g\n", total ? (double)value / total : 0.0);
+        }
+    }
+}
+
+/** Formats the metrics of the latest update and publishes them. */
+static void
+ExportPublish() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    FrameClear(&export_back);
+    ExportFamily(
+        &export_back,
+        "sm_last_update_timestamp_seconds",
+        "gauge",
+        "When the collectors were last updated."
+    );
+    FramePrintf(
+        &export_back,
+        "sm_last_update_timestamp_seconds %ld.%03ld\n",
+        (long)now.tv_sec,
+        now.tv_nsec / 1000000L
+    );
+    ExportCpu(&export_back);
+    ExportMemory(&export_back);
+    ExportNetwork(&export_back);
+    ExportDisk(&export_back);
+    ExportTemp(&export_back);
+    ExportProcs(&export_back);
+    pthread_mutex_lock(&export_mutex);
+    const Frame swap = export_front;
+    export_front = export_back;
+    export_back = swap;
+    pthread_mutex_unlock(&export_mutex);
+}
+
+static bool
+ExportSendAll(int fd, const uint8_t *data, size_t size) {
+    while (size) {
+        const ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+/** Reads the request head and answers it from the published metrics. */
+static void
+ExportServe(int fd, Frame *response) {
+    char request[EXPORT_REQUEST_SIZE + 1];
+    size_t size = 0;
+    while (size < EXPORT_REQUEST_SIZE) {
+        const ssize_t n
+            = recv(fd, request + size, EXPORT_REQUEST_SIZE - size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        size += n;
+        request[size] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) {
+            break;
+        }
+    }
+    request[size] = '\0';
+
+    FrameClear(response);
+    const size_t path_length = strcspn(request + 4, " \r\n");
+    const bool get = strncmp(request, "GET ", 4) == 0;
+    const bool found = get
+                       && ((path_length == 1 && request[4] == '/')
+                           || (path_length == 8
+                               && strncmp(request + 4, "/metrics", 8) == 0));
+    if (!found) {
+        static const char not_found[] = "HTTP/1.0 404 Not Found\r\n"
+                                        "Content-Length: 0\r\n"
+                                        "Connection: close\r\n\r\n";
+        ExportSendAll(fd, (const uint8_t *)not_found, strlen(not_found));
+        return;
+    }
+    pthread_mutex_lock(&export_mutex);
+    FramePrintf(
+        response,
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+        "Content-Length: %zu\r\n"
+        "Connection: close\r\n\r\n",
+        export_front.size
+    );
+    FramePutBytes(response, export_front.data, export_front.size);
+    pthread_mutex_unlock(&export_mutex);
+    ExportSendAll(fd, response->data, response->size);
+}
+
+static void *
+ExportServer(void *arg) {
+    (void)arg;
+    // Reused for every scrape, it only grows with the metrics.
+    Frame response;
+    FrameConstruct(&response, 4096);
+    // A client that stalls must not keep the others waiting for long.
+    const struct timeval timeout = {1, 0};
+    for (;;) {
+        const int fd = accept4(export_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // The socket got shut down by `Export`.
+            break;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        ExportServe(fd, &response);
+        close(fd);
+    }
+    FrameDestroy(&response);
+    return NULL;
+}
+
+int
+Export(const char *address, const Batch_Options *options) {
+    export_options = options;
+    export_fd = SocketListen(address);
+    if (export_fd < 0) {
+        return 1;
+    }
+    export_stopping = false;
+    signal(SIGINT, ExportStop);
+    signal(SIGTERM, ExportStop);
+    signal(SIGPIPE, SIG_IGN);
+
+    BatchCollectorInit(options->fields);
+    FrameConstruct(&export_front, 4096);
+    FrameConstruct(&export_back, 4096);
+    pthread_mutex_init(&export_mutex, NULL);
+    // Scrapes get an empty response until the first update is done, the
+    // graphs have no samples before that.
+    pthread_create(&export_thread, NULL, ExportServer, NULL);
+
+    while (!export_stopping) {
+        nanosleep(&interval, NULL);
+        if (export_stopping) {
+            break;
+        }
+        BatchCollectorUpdate(options->fields);
+        ExportPublish();
+    }
+
+    shutdown(export_fd, SHUT_RDWR);
+    pthread_join(export_thread, NULL);
+    SocketClose(export_fd, address);
+    export_fd = -1;
+    pthread_mutex_destroy(&export_mutex);
+    FrameDestroy(&export_front);
+    FrameDestroy(&export_back);
+    BatchCollectorQuit(options->fields);
+    return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "batch.h"
+#include "stdafx.h"
+
+/** Longest command line put into a process label, in bytes. */
+#define EXPORT_COMMAND_LENGTH 256
+
+/** Maximum size of a scrape request, anything after it is ignored. */
+#define EXPORT_REQUEST_SIZE 4096
+
+/** Serves the fields selected in `options` in the Prometheus text format over
+    HTTP, on a Unix socket if `address` contains a slash and on that port of
+    127.0.0.1 otherwise.  The collectors are updated once per interval and
+    scrapes only copy out the text built by the last update.  Runs until
+    SIGINT or SIGTERM, returns the exit status. */
+int Export(const char *address, const Batch_Options *options);
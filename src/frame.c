@@ -0,0 +1,162 @@
+#include "frame.h"
+
+void
+FrameConstruct(Frame *self, size_t capacity) {
+    self->data = malloc(capacity);
+    self->size = 0;
+    self->capacity = capacity;
+}
+
+void
+FrameDestroy(Frame *self) {
+    free(self->data);
+}
+
+static inline uint8_t *
+FrameReserve(Frame *self, size_t size) {
+    if (unlikely(self->size + size > self->capacity)) {
+        while (self->size + size > self->capacity) {
+            self->capacity *= 2;
+        }
+        self->data = realloc(self->data, self->capacity);
+    }
+    uint8_t *p = self->data + self->size;
+    self->size += size;
+    return p;
+}
+
+void
+FramePutU8(Frame *self, uint8_t value) {
+    *FrameReserve(self, 1) = value;
+}
+
+void
+FramePutRatio(Frame *self, double value) {
+    // Written the other way around so NaN ends up as 0.
+    value = value > 0.0 ? Min(value, 1.0) : 0.0;
+    const uint16_t q = (uint16_t)round(value * UINT16_MAX);
+    uint8_t *p = FrameReserve(self, 2);
+    p[0] = q & 0xff;
+    p[1] = q >> 8;
+}
+
+void
+FramePutVarint(Frame *self, uint64_t value) {
+    // 10 bytes is the most a 64-bit value can take.
+    uint8_t *p = FrameReserve(self, 10);
+    uint8_t *const begin = p;
+    while (value >= 0x80) {
+        *p++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    self->size -= 10 - (p - begin);
+}
+
+void
+FramePutSvarint(Frame *self, int64_t value) {
+    FramePutVarint(self, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void
+FrameInsertVarint(Frame *self, size_t offset, uint64_t value) {
+    uint8_t encoded[10];
+    Frame tmp = {encoded, 0, sizeof(encoded)};
+    FramePutVarint(&tmp, value);
+    FrameReserve(self, tmp.size);
+    memmove(
+        self->data + offset + tmp.size,
+        self->data + offset,
+        self->size - tmp.size - offset
+    );
+    memcpy(self->data + offset, encoded, tmp.size);
+}
+
+void
+FramePutBytes(Frame *self, const void *data, size_t size) {
+    memcpy(FrameReserve(self, size), data, size);
+}
+
+void
+FramePutString(Frame *self, const char *s) {
+    const size_t length = strlen(s);
+    FramePutVarint(self, length);
+    FramePutBytes(self, s, length);
+}
+
+void
+FramePrintf(Frame *self, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    const size_t available = self->capacity - self->size;
+    const int n
+        = vsnprintf((char *)self->data + self->size, available, format, args);
+    va_end(args);
+    if ((size_t)n >= available) {
+        // Make room for the terminator too, it gets overwritten next time.
+        FrameReserve(self, n + 1);
+        self->size -= n + 1;
+        va_start(args, format);
+        vsnprintf((char *)self->data + self->size, n + 1, format, args);
+        va_end(args);
+    }
+    self->size += n;
+}
+
+uint8_t
+FrameGetU8(Frame_Reader *self) {
+    if (unlikely(self->p == self->end)) {
+        self->error = true;
+        return 0;
+    }
+    return *self->p++;
+}
+
+double
+FrameGetRatio(Frame_Reader *self) {
+    const uint16_t lo = FrameGetU8(self);
+    const uint16_t hi = FrameGetU8(self);
+    return (double)(lo | hi << 8) / UINT16_MAX;
+}
+
+uint64_t
+FrameGetVarint(Frame_Reader *self) {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        const uint8_t byte = FrameGetU8(self);
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    self->error = true;
+    return 0;
+}
+
+int64_t
+FrameGetSvarint(Frame_Reader *self) {
+    const uint64_t value = FrameGetVarint(self);
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+const void *
+FrameGetBytes(Frame_Reader *self, size_t size) {
+    if (unlikely((size_t)(self->end - self->p) < size)) {
+        self->error = true;
+        self->p = self->end;
+        return NULL;
+    }
+    const void *p = self->p;
+    self->p += size;
+    return p;
+}
+
+char *
+FrameGetString(Frame_Reader *self) {
+    const size_t length = FrameGetVarint(self);
+    const char *bytes = FrameGetBytes(self, length);
+    if (bytes == NULL) {
+        return strdup("");
+    }
+    return strndup(bytes, length);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "stdafx.h"
+
+/** A growable byte buffer that samples get encoded into.  Integers are stored
+    as LEB128 varints, signed ones zigzag encoded first. */
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} Frame;
+
+/** Reads back what was written to a `Frame`.  Reading past the end sets
+    `error` and returns zeros instead of failing. */
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    bool error;
+} Frame_Reader;
+
+void FrameConstruct(Frame *self, size_t capacity);
+void FrameDestroy(Frame *self);
+
+static inline void
+FrameClear(Frame *self) {
+    self->size = 0;
+}
+
+void FramePutU8(Frame *self, uint8_t value);
+/** Stores a value in 0~1 with 16 bits of precision, anything outside the
+    range (including NaN) is clamped. */
+void FramePutRatio(Frame *self, double value);
+void FramePutVarint(Frame *self, uint64_t value);
+void FramePutSvarint(Frame *self, int64_t value);
+/** Inserts a varint at the given offset, moving everything after it back. */
+void FrameInsertVarint(Frame *self, size_t offset, uint64_t value);
+void FramePutBytes(Frame *self, const void *data, size_t size);
+/** Stores the length followed by the bytes, without a terminator. */
+void FramePutString(Frame *self, const char *s);
+/** Appends formatted text, without a terminator. */
+__attribute__((format(printf, 2, 3))) void
+FramePrintf(Frame *self, const char *format, ...);
+
+static inline Frame_Reader
+FrameReader(const void *data, size_t size) {
+    return (Frame_Reader){data, (const uint8_t *)data + size, false};
+}
+
+static inline bool
+FrameReaderDone(const Frame_Reader *self) {
+    return self->error || self->p == self->end;
+}
+
+uint8_t FrameGetU8(Frame_Reader *self);
+double FrameGetRatio(Frame_Reader *self);
+uint64_t FrameGetVarint(Frame_Reader *self);
+int64_t FrameGetSvarint(Frame_Reader *self);
+/** Returns a pointer to the next `size` bytes within the frame, or NULL. */
+const void *FrameGetBytes(Frame_Reader *self, size_t size);
+/** Returns a newly allocated, null terminated copy of the string. */
+char *FrameGetString(Frame_Reader *self);
@@ -8,7 +8,14 @@ typedef struct {
     Canvas *const canvas;
     const Rectangle viewport;
     const unsigned scale;
-    const bool fill;
+    /** Range of the samples mapped to the viewport height */
+    const double lowest_sample, highest_sample;
+    /** Pixel row of the viewport top and pixels between samples */
+    const double top_y, step;
+    /** Where filled graphs record the highest pixel of the source being
+        drawn in each of the `n_tops` pixel columns */
+    int16_t *tops;
+    const size_t n_tops;
     short color;
     /** Left point, older sample */
     double x1, y1;
@@ -16,116 +23,139 @@ typedef struct {
     double x2, y2;
 } GraphDrawContext;
 
-typedef void (*DrawLineFn)(const GraphDrawContext *restrict);
+/// Lowest pixel row of the viewport on the canvas, see `GraphDraw` about the
+/// `- 1`.
+static inline double
+ViewportBottom(const GraphDrawContext *restrict ctx) {
+    return (ctx->viewport.y - 1 + ctx->viewport.height) * 4.0 - 1.0;
+}
 
-static void
+static inline void
 DrawLine(const GraphDrawContext *restrict ctx) {
-    if (false && ctx->fill) {
-        // FIXME: this is invalid when the viewport does not stretch to the
-        // bottom of the canvas.
-        CanvasDrawLineFill(
-            ctx->canvas, ctx->x1, ctx->y1, ctx->x2, ctx->y2, ctx->color
-        );
-    } else {
-        CanvasDrawLine(
-            ctx->canvas, ctx->x1, ctx->y1, ctx->x2, ctx->y2, ctx->color
-        );
-    }
+    CanvasDrawLine(ctx->canvas, ctx->x1, ctx->y1, ctx->x2, ctx->y2, ctx->color);
 }
 
-static void
-DrawBezir(const GraphDrawContext *restrict ctx) {
-    // Create locals for the values used in the loop to prevent the repeated
-    // memory indirection. Not sure if this actually does anything but it
-    // shouldn't hurt either.
-    Canvas *const canvas = ctx->canvas;
-    // Flipping the 1 and 2 points is intentional here because of how this
-    // used to be called.
+static inline void
+DrawLineFill(const GraphDrawContext *restrict ctx) {
+    CanvasLineTops(
+        ctx->canvas,
+        ctx->x1,
+        ctx->y1,
+        ctx->x2,
+        ctx->y2,
+        ctx->tops,
+        ctx->n_tops
+    );
+}
+
+/// How far the chords the curve is split into may stray from it, in pixels.
+#define BEZIR_TOLERANCE 0.5
+#define BEZIR_MAX_STEPS 256
+
+/// `fill` is always a constant, the callers below each get their own copy.
+static inline void
+DrawBezirCurve(const GraphDrawContext *restrict ctx, const bool fill) {
     const double x1 = ctx->x1;
     const double y1 = ctx->y1;
     const double x2 = ctx->x2;
     const double y2 = ctx->y2;
-    const short color = ctx->color;
     if ((x2 - x1) < 1.0 || fabs(y1 - y2) < 1.0) {
-        CanvasDrawLine(canvas, x1, y1, x2, y2, color);
+        if (fill) {
+            DrawLineFill(ctx);
+        } else {
+            DrawLine(ctx);
+        }
         return;
     }
-    // TODO: we still get holes in these sometimes, should probably reduce the
-    // number of points we calculate and then draw straight lines between those.
     /* Arbitrary constant that defined how squiggly(?) the bezir curve will be;
        0.0 -> straight line, 2.0 -> very shallow at beginning, vertical in the
        middle. Values less than 0.0 or greater than 2.0 will cause it to overlap
        itself. */
 #define CONTROL_FACTOR ((2.0 + 1.618) / 3.0)
-    const double dx = (x2 - x1) * 2.0;
-    const double dy = fabs(y1 - y2);
-    const double percision = 0.9 / (dx > dy ? dx : dy);
     /* Control point coordinates.
        Invariant: x2 > x1 */
     const double x1_c = x1 + ctx->scale * CONTROL_FACTOR;
     const double x2_c = x2 - ctx->scale * CONTROL_FACTOR;
     const double y1_c = y1;
     const double y2_c = y2;
-    const double bottom = ctx->viewport.height * 4.0 - 1.0;
-    double d, d2, d3, w1, w2, w3, w4, x, y;
-    for (d = 0.0; d <= 1.0; d += percision) {
-        // clang-format off
-        d2 = d * d;
-        d3 = d2 * d;
-        w1 =   -d3 + 3*d2 - 3*d + 1;
-        w2 =  3*d3 - 6*d2 + 3*d    ;
-        w3 = -3*d3 + 3*d2          ;
-        w4 =    d3                 ;
-        x = x1*w1 + x1_c*w2 + x2_c*w3 + x2*w4;
-        if (x < 0.0) {
-            continue;
+    // A chord over a step of h strays at most h^2 / 8 times the largest
+    // second derivative from the curve, which is 6 times the largest second
+    // difference of the control points.  The chords are joined end to end
+    // so there are no holes however steep it gets.
+    const double bend1 = hypot(x1 - 2 * x1_c + x2_c, y1 - 2 * y1_c + y2_c);
+    const double bend2 = hypot(x1_c - 2 * x2_c + x2, y1_c - 2 * y2_c + y2);
+    const double bend = 6.0 * fmax(bend1, bend2);
+    const unsigned steps = Clamp(
+        ceil(sqrt(bend / (8.0 * BEZIR_TOLERANCE))), 1, BEZIR_MAX_STEPS
+    );
+    const double h = 1.0 / steps;
+    // Forward differences of the cubic, as a*t^3 + b*t^2 + c*t + p1 its
+    // first three differences for a step of h start at
+    //   a*h^3 + b*h^2 + c*h, 6*a*h^3 + 2*b*h^2, 6*a*h^3
+    // and each one is advanced by the next.
+    const double ax = -x1 + 3 * x1_c - 3 * x2_c + x2;
+    const double bx = 3 * x1 - 6 * x1_c + 3 * x2_c;
+    const double cx = -3 * x1 + 3 * x1_c;
+    const double ay = -y1 + 3 * y1_c - 3 * y2_c + y2;
+    const double by = 3 * y1 - 6 * y1_c + 3 * y2_c;
+    const double cy = -3 * y1 + 3 * y1_c;
+    const double h2 = h * h;
+    const double h3 = h2 * h;
+    double dx = ax * h3 + bx * h2 + cx * h;
+    double ddx = 6 * ax * h3 + 2 * bx * h2;
+    const double dddx = 6 * ax * h3;
+    double dy = ay * h3 + by * h2 + cy * h;
+    double ddy = 6 * ay * h3 + 2 * by * h2;
+    const double dddy = 6 * ay * h3;
+    double x = x1, y = y1;
+    for (unsigned i = 1; i <= steps; ++i) {
+        double next_x = x + dx;
+        double next_y = y + dy;
+        if (i == steps) {
+            // Don't let rounding errors add up into the next segment.
+            next_x = x2;
+            next_y = y2;
         }
-        y = y1 * w1 + y1_c * w2 + y2_c * w3 + y2 * w4;
-        // clang-format on
-        if (ctx->fill) {
-            for (double yy = bottom; yy >= y; --yy) {
-                CanvasSet(ctx->canvas, x, yy, ctx->color);
-            }
+        dx += ddx;
+        ddx += dddx;
+        dy += ddy;
+        ddy += dddy;
+        if (fill) {
+            CanvasLineTops(
+                ctx->canvas, x, y, next_x, next_y, ctx->tops, ctx->n_tops
+            );
         } else {
-            CanvasSet(canvas, x, y, color);
+            CanvasDrawLine(ctx->canvas, x, y, next_x, next_y, ctx->color);
         }
+        x = next_x;
+        y = next_y;
     }
 }
 
-static void
+static inline void
+DrawBezir(const GraphDrawContext *restrict ctx) {
+    DrawBezirCurve(ctx, false);
+}
+
+static inline void
+DrawBezirFill(const GraphDrawContext *restrict ctx) {
+    DrawBezirCurve(ctx, true);
+}
+
+static inline void
 DrawBlocks(const GraphDrawContext *restrict ctx) {
-    if (ctx->fill) {
-        // See `GraphDraw` about the `- 1`.
-        const double bottom
-            = (ctx->viewport.y - 1 + ctx->viewport.height) * 4.0 - 1.0;
-        CanvasDrawRect(
-            ctx->canvas, ctx->x1, bottom, ctx->x2 - 1, ctx->y2, ctx->color
-        );
-    } else {
-        for (double xx = Max(0.0, ctx->x1); xx <= ctx->x2; ++xx) {
-            CanvasSet(ctx->canvas, xx, ctx->y2, ctx->color);
-        }
-        if (ctx->x1 >= 0.0) {
-            const double y1 = Min(ctx->y1, ctx->y2);
-            const double y2 = Max(ctx->y1, ctx->y2);
-            for (double yy = y1; yy <= y2; ++yy) {
-                CanvasSet(ctx->canvas, ctx->x1, yy, ctx->color);
-            }
-        }
-    }
+    CanvasDrawLine(ctx->canvas, ctx->x1, ctx->y2, ctx->x2, ctx->y2, ctx->color);
+    CanvasDrawLine(ctx->canvas, ctx->x1, ctx->y1, ctx->x1, ctx->y2, ctx->color);
 }
 
-static DrawLineFn
-GraphKindLineDrawer(Graph_Kind kind) {
-    switch (kind) {
-    case GRAPH_KIND_STRAIGHT:
-        return DrawLine;
-    case GRAPH_KIND_BEZIR:
-        return DrawBezir;
-    case GRAPH_KIND_BLOCKS:
-        return DrawBlocks;
+static inline void
+DrawBlocksFill(const GraphDrawContext *restrict ctx) {
+    const long from = Max(lround(ctx->x1), 0L);
+    const long to = Min(lround(ctx->x2 - 1), (long)ctx->n_tops - 1);
+    const int16_t top = Clamp(lround(ctx->y2), (long)INT16_MIN, INT16_MAX - 1L);
+    for (long x = from; x <= to; ++x) {
+        ctx->tops[x] = Min(ctx->tops[x], top);
     }
-    __builtin_unreachable();
 }
 
 static void
@@ -151,7 +181,12 @@ GraphKindFromString(const char *s, Graph_Kind *out) {
 }
 
 void
-GetGraphOptions(const char *domain, Graph_Kind *kind_out, unsigned *scale_out) {
+GetGraphOptions(
+    const char *domain,
+    Graph_Kind *kind_out,
+    unsigned *scale_out,
+    Graph_Fill *fill_out
+) {
     if (!HaveConfig()) {
         return;
     }
@@ -162,15 +197,136 @@ GetGraphOptions(const char *domain, Graph_Kind *kind_out, unsigned *scale_out) {
     if ((v = ConfigGet(domain, "graph-scale"))) {
         *scale_out = v->as_unsigned();
     }
+    if ((v = ConfigGet(domain, "graph-fill"))) {
+        *fill_out = v->as_bool() ? GRAPH_FILL_ON : GRAPH_FILL_OFF;
+    }
+}
+
+/** How many rows of the level below make up a row of the level, for an
+    interval of 1s the levels are 10s, 1m, 10m and 1h. */
+static const unsigned graph_history_factors[GRAPH_HISTORY_LEVELS] = {
+    1,
+    10,
+    6,
+    10,
+    6,
+};
+
+static unsigned graph_zoom = 0;
+
+/** How far back the graphs are showing, in samples. */
+static size_t graph_pan = 0;
+
+/** How far back `graph_pan` can go at each zoom level. */
+static size_t graph_pan_limit[GRAPH_HISTORY_LEVELS];
+
+/** Time of the newest point shown while panned. */
+static uint64_t graph_pan_time;
+
+/** See `GraphSetSampleTime`. */
+static uint64_t graph_sample_time = 0;
+
+/** Returns the i-th oldest sample of the source. */
+static inline double
+GraphSample(const Graph *self, size_t source, size_t i) {
+    const size_t index = self->rings[source].start + i;
+    return self->samples
+        [source * self->capacity
+         + (index < self->capacity ? index : index - self->capacity)];
+}
+
+/** Returns the i-th point drawn for the source, from `view` if it is not
+    NULL. */
+static inline double
+GraphPoint(const Graph *self, const double *view, size_t source, size_t i) {
+    return view ? view[i] : GraphSample(self, source, i);
+}
+
+/** Returns the storage of the source's maxima deque, the minima follow it. */
+static inline size_t *
+GraphExtrema(const Graph *self, size_t source) {
+    return self->extrema + source * 2 * self->capacity;
+}
+
+static inline size_t
+GraphDequeAt(const Graph *self, const Graph_Deque *deque, size_t i) {
+    const size_t index = deque->front + i;
+    return index < self->capacity ? index : index - self->capacity;
+}
+
+/** Adds the sample at `index` to the back of the deque, dropping every sample
+    it outranks as those can never be the extreme again. */
+static inline void
+GraphDequePush(
+    Graph *self,
+    Graph_Deque *deque,
+    size_t *indices,
+    const double *block,
+    size_t index,
+    bool maxima
+) {
+    const double sample = block[index];
+    while (deque->count > 0) {
+        const double back
+            = block[indices[GraphDequeAt(self, deque, deque->count - 1)]];
+        if (maxima ? back > sample : back < sample) {
+            break;
+        }
+        --deque->count;
+    }
+    indices[GraphDequeAt(self, deque, deque->count++)] = index;
+}
+
+static inline void
+GraphDequeExpire(
+    Graph *self, Graph_Deque *deque, const size_t *indices, size_t index
+) {
+    if (deque->count > 0 && indices[deque->front] == index) {
+        if (++deque->front == self->capacity) {
+            deque->front = 0;
+        }
+        --deque->count;
+    }
+}
+
+/** Removes the oldest sample of the source. */
+static void
+GraphDropOldest(Graph *self, size_t source) {
+    Graph_Ring *ring = &self->rings[source];
+    size_t *extrema = GraphExtrema(self, source);
+    GraphDequeExpire(self, &ring->maxima, extrema, ring->start);
+    GraphDequeExpire(
+        self, &ring->minima, extrema + self->capacity, ring->start
+    );
+    if (++ring->start == self->capacity) {
+        ring->start = 0;
+    }
+    --ring->count;
 }
 
 void
 GraphConstruct(Graph *self, Graph_Kind kind, size_t n_sources, unsigned scale) {
     self->kind = kind;
-    self->samples = calloc(n_sources, sizeof(List *));
+    self->capacity = 1;
+    self->samples = malloc(n_sources * self->capacity * sizeof(double));
+    self->rings = calloc(n_sources, sizeof(Graph_Ring));
+    self->extrema = malloc(n_sources * 2 * self->capacity * sizeof(size_t));
+    self->history
+        = calloc(n_sources * (GRAPH_HISTORY_LEVELS - 1), sizeof(Graph_Level));
+    self->series = malloc(n_sources * sizeof(Series));
     for (size_t i = 0; i < n_sources; ++i) {
-        self->samples[i] = list_create();
+        SeriesConstruct(&self->series[i]);
     }
+    self->view = NULL;
+    self->view_counts = calloc(n_sources, sizeof(size_t));
+    self->drawn_canvas = NULL;
+    self->column = NULL;
+    self->tops = NULL;
+    self->fill_order = malloc(n_sources * sizeof(size_t));
+    for (size_t i = 0; i < n_sources; ++i) {
+        self->fill_order[i] = i;
+    }
+    self->fill = n_sources == 1;
     self->n_sources = n_sources;
     self->max_samples = 1;
     self->scale = scale;
@@ -185,21 +341,72 @@ GraphConstruct(Graph *self, Graph_Kind kind, size_t n_sources, unsigned scale) {
 
 void
 GraphDestroy(Graph *self) {
+    free(self->samples);
+    free(self->rings);
+    free(self->extrema);
+    free(self->history);
     for (size_t i = 0; i < self->n_sources; ++i) {
-        list_delete(self->samples[i]);
+        SeriesDestroy(&self->series[i]);
     }
-    free(self->samples);
+    free(self->series);
+    free(self->view);
+    free(self->view_counts);
+    if (self->column) {
+        CanvasDelete(self->column);
+    }
+    free(self->tops);
+    free(self->fill_order);
     vector_free(self->set_colors);
 }
 
+/** Moves the samples into a block with room for `capacity` samples per
+    source, each ring starts at the beginning of its part afterwards. */
+static void
+GraphSetCapacity(Graph *self, size_t capacity) {
+    double *samples = malloc(self->n_sources * capacity * sizeof(double));
+    size_t *extrema = malloc(self->n_sources * 2 * capacity * sizeof(size_t));
+    for (size_t source = 0; source < self->n_sources; ++source) {
+        Graph_Ring *ring = &self->rings[source];
+        for (size_t i = 0; i < ring->count; ++i) {
+            samples[source * capacity + i] = GraphSample(self, source, i);
+        }
+        // The deques keep their order, only the indices move along with the
+        // samples.
+        const size_t *old_extrema = GraphExtrema(self, source);
+        Graph_Deque *deques[2] = {&ring->maxima, &ring->minima};
+        for (int d = 0; d < 2; ++d) {
+            const size_t *from = old_extrema + d * self->capacity;
+            size_t *to = extrema + (source * 2 + d) * capacity;
+            for (size_t i = 0; i < deques[d]->count; ++i) {
+                const size_t index = from[GraphDequeAt(self, deques[d], i)];
+                to[i] = index >= ring->start ? index - ring->start
+                                             : index + self->capacity
+                                                   - ring->start;
+            }
+            deques[d]->front = 0;
+        }
+        ring->start = 0;
+    }
+    free(self->samples);
+    free(self->extrema);
+    free(self->view);
+    self->view = NULL;
+    self->samples = samples;
+    self->extrema = extrema;
+    self->capacity = capacity;
+}
+
 static void
 GraphSetMaxSamples(Graph *self, size_t max_samples) {
-    if (max_samples >= self->max_samples) {
-        self->max_samples = max_samples;
-        return;
+    // Only resizing the window changes this, so the block is only ever grown
+    // to the largest size needed so far.
+    if (max_samples > self->capacity) {
+        GraphSetCapacity(self, max_samples);
     }
     for (size_t i = 0; i < self->n_sources; ++i) {
-        list_shrink(self->samples[i], max_samples);
+        while (self->rings[i].count > max_samples) {
+            GraphDropOldest(self, i);
+        }
     }
     self->max_samples = max_samples;
 }
@@ -207,11 +414,38 @@ GraphSetMaxSamples(Graph *self, size_t max_samples) {
 void
 GraphSetViewport(Graph *self, Rectangle viewport) {
     // We need 1 extra sample as the scale equation only gives us the number of
-    // line segments we need which is 1 less than the number of samples.
+    // line segments we need which is 1 less than the number of samples.  One
+    // more makes sure the segment that gets dropped is entirely outside the
+    // viewport, as scrolling would otherwise keep its right end.
+    // Windows smaller than their border give an empty viewport.
+    viewport.width = Max(viewport.width, 0);
+    viewport.height = Max(viewport.height, 0);
     GraphSetMaxSamples(
-        self, 1 + (viewport.width + self->scale - 1) / self->scale
+        self, 2 + (viewport.width + self->scale - 1) / self->scale
     );
     self->viewport = viewport;
+    if (self->column == NULL) {
+        self->column = CanvasCreateSized(1, viewport.height);
+    } else {
+        CanvasResizeTo(self->column, 1, viewport.height);
+    }
+    self->tops = realloc(
+        self->tops, self->n_sources * viewport.width * 2 * sizeof(int16_t)
+    );
+    GraphInvalidate(self);
+}
+
+void
+GraphSetFill(Graph *self, Graph_Fill fill) {
+    if (fill != GRAPH_FILL_DEFAULT) {
+        self->fill = fill == GRAPH_FILL_ON;
+        GraphInvalidate(self);
+    }
+}
+
+void
+GraphInvalidate(Graph *self) {
+    self->drawn_canvas = NULL;
 }
 
 void
@@ -227,20 +461,85 @@ GraphApplyStep(double sample, double step, bool up) {
     return round(sample / step) * step + up * step;
 }
 
+/** Fills `view` with the points to draw for every source when zoomed out or
+    panned, writing the range they cover to `lo_out` and `hi_out`. */
+static void
+GraphFillView(Graph *self, double *lo_out, double *hi_out) {
+    if (self->view == NULL) {
+        self->view = malloc(self->n_sources * self->capacity * sizeof(double));
+    }
+    double lo = 0.0, hi = 0.0;
+    bool first = true;
+    for (size_t source = 0; source < self->n_sources; ++source) {
+        double *view = self->view + source * self->capacity;
+        size_t count = 0;
+        if (graph_zoom > 0) {
+            // The extremes of the rows are used for the range so peaks are
+            // not cut off by the averages.
+            const Graph_Level *level
+                = &self->history
+                       [source * (GRAPH_HISTORY_LEVELS - 1) + graph_zoom - 1];
+            const size_t offset = graph_pan / GraphZoomFactor();
+            if (offset < level->count) {
+                const size_t end = level->count - offset;
+                count = Min(end, self->max_samples);
+                for (size_t i = 0; i < count; ++i) {
+                    const Graph_Row *row = &level->rows
+                        [(level->start + end - count + i)
+                         % GRAPH_HISTORY_ROWS];
+                    view[i] = row->avg;
+                    lo = first ? row->min : Min(lo, (double)row->min);
+                    hi = first ? row->max : Max(hi, (double)row->max);
+                    first = false;
+                }
+            }
+        } else {
+            const Series *series = &self->series[source];
+            Series_Reader reader;
+            uint64_t time;
+            if (graph_pan < series->count) {
+                const size_t end = series->count - graph_pan;
+                count = Min(end, self->max_samples);
+                SeriesSeek(series, &reader, end - count);
+                for (size_t i = 0; i < count; ++i) {
+                    if (!SeriesNext(&reader, &time, &view[i])) {
+                        count = i;
+                        break;
+                    }
+                    lo = first ? view[i] : Min(lo, view[i]);
+                    hi = first ? view[i] : Max(hi, view[i]);
+                    first = false;
+                }
+            }
+        }
+        self->view_counts[source] = count;
+    }
+    *lo_out = GraphApplyStep(lo, self->range_step, false);
+    *hi_out = GraphApplyStep(hi, self->range_step, true);
+
+    Series_Reader reader;
+    const Series *series = &self->series[0];
+    double value;
+    graph_pan_time = 0;
+    if (graph_pan > 0 && graph_pan < series->count
+        && SeriesSeek(series, &reader, series->count - 1 - graph_pan)) {
+        SeriesNext(&reader, &graph_pan_time, &value);
+    }
+}
+
 static void
 GraphGetRange(Graph *self, double *lo_out, double *hi_out) {
-    double s;
-    double lo = self->samples[0]->back->f;
+    double lo = GraphLastSample(self, 0);
     double hi = lo;
-    for (size_t i = 0; i < self->n_sources; ++i) {
-        list_for_each(self->samples[i], it) {
-            s = it->f;
-            if (s > hi) {
-                hi = s;
-            } else if (s < lo) {
-                lo = s;
-            }
+    for (size_t source = 0; source < self->n_sources; ++source) {
+        const Graph_Ring *ring = &self->rings[source];
+        if (ring->count == 0) {
+            continue;
         }
+        const double *block = self->samples + source * self->capacity;
+        const size_t *extrema = GraphExtrema(self, source);
+        hi = Max(hi, block[extrema[ring->maxima.front]]);
+        lo = Min(lo, block[extrema[self->capacity + ring->minima.front]]);
     }
     *lo_out = GraphApplyStep(lo, self->range_step, false);
     *hi_out = GraphApplyStep(hi, self->range_step, true);
@@ -255,19 +554,154 @@ GraphSetDynamicRange(Graph *self, double step) {
 void
 GraphSetScale(Graph *self, unsigned scale, bool update_max_samples) {
     self->scale = scale;
+    GraphInvalidate(self);
     if (update_max_samples) {
         GraphSetViewport(self, self->viewport);
     }
 }
 
+/** Feeds a row into the consolidated levels of the source, a completed row
+    is passed on to the next level. */
+static void
+GraphConsolidate(Graph *self, size_t source, Graph_Row row) {
+    Graph_Level *levels
+        = &self->history[source * (GRAPH_HISTORY_LEVELS - 1)];
+    size_t factor = 1;
+    for (int i = 1; i < GRAPH_HISTORY_LEVELS; ++i) {
+        factor *= graph_history_factors[i];
+        Graph_Level *level = &levels[i - 1];
+        Graph_Row *pending = &level->pending;
+        if (level->pending_count == 0) {
+            *pending = row;
+        } else {
+            pending->min = Min(pending->min, row.min);
+            pending->avg += row.avg;
+            pending->max = Max(pending->max, row.max);
+        }
+        if (++level->pending_count < graph_history_factors[i]) {
+            return;
+        }
+        pending->avg /= level->pending_count;
+        level->pending_count = 0;
+        row = *pending;
+        if (level->count < GRAPH_HISTORY_ROWS) {
+            level->rows[(level->start + level->count++) % GRAPH_HISTORY_ROWS]
+                = row;
+        } else {
+            level->rows[level->start] = row;
+            level->start = (level->start + 1) % GRAPH_HISTORY_ROWS;
+        }
+        graph_pan_limit[i] = Max(graph_pan_limit[i], level->count * factor);
+    }
+}
+
+void
+GraphSetSampleTime(uint64_t time) {
+    graph_sample_time = time;
+}
+
 void
 GraphAddSample(Graph *self, size_t source, double sample) {
-    List *list = self->samples[source];
-    if (likely(list->count == self->max_samples)) {
-        list_rotate_left(list)->f = sample;
+    // Tenths of a second, so the jitter of the interval rarely shows up in
+    // the timestamps and they take a single bit.
+    uint64_t time = graph_sample_time;
+    if (time == 0) {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME_COARSE, &now);
+        time = now.tv_sec * 10 + now.tv_nsec / 100000000;
+    }
+    Series *series = &self->series[source];
+    const size_t count = series->count;
+    SeriesAppend(series, time, sample);
+    // The oldest block was reused, the samples in it can't be panned to.
+    if (series->count <= count) {
+        graph_pan_limit[0] = Min(graph_pan_limit[0], series->count);
+    }
+    graph_pan_limit[0] = Max(graph_pan_limit[0], series->count);
+    GraphConsolidate(self, source, (Graph_Row){sample, sample, sample});
+    Graph_Ring *ring = &self->rings[source];
+    if (likely(ring->count == self->max_samples)) {
+        GraphDropOldest(self, source);
+    }
+    size_t index = ring->start + ring->count;
+    if (index >= self->capacity) {
+        index -= self->capacity;
+    }
+    double *block = self->samples + source * self->capacity;
+    size_t *extrema = GraphExtrema(self, source);
+    block[index] = sample;
+    ++ring->count;
+    ++ring->added;
+    GraphDequePush(self, &ring->maxima, extrema, block, index, true);
+    GraphDequePush(
+        self, &ring->minima, extrema + self->capacity, block, index, false
+    );
+}
+
+void
+GraphClear(Graph *self) {
+    for (size_t i = 0; i < self->n_sources; ++i) {
+        self->rings[i] = (Graph_Ring){0};
+    }
+    memset(
+        self->history,
+        0,
+        self->n_sources * (GRAPH_HISTORY_LEVELS - 1) * sizeof(Graph_Level)
+    );
+    for (size_t i = 0; i < self->n_sources; ++i) {
+        SeriesClear(&self->series[i]);
+    }
+    // The other graphs raise the limits again with their next samples.
+    memset(graph_pan_limit, 0, sizeof(graph_pan_limit));
+    GraphInvalidate(self);
+}
+
+bool
+GraphZoom(int delta) {
+    const int zoom = Clamp(
+        (int)graph_zoom + delta, 0, (int)GRAPH_HISTORY_LEVELS - 1
+    );
+    if ((unsigned)zoom == graph_zoom) {
+        return false;
+    }
+    graph_zoom = zoom;
+    return true;
+}
+
+bool
+GraphPan(int delta) {
+    const size_t step = GRAPH_PAN_STEP * GraphZoomFactor();
+    size_t pan = graph_pan;
+    if (delta > 0) {
+        // Stop at the last step that still shows something.
+        const size_t limit = graph_pan_limit[graph_zoom];
+        pan = Min(pan + step, limit > 1 ? limit - 1 : 0);
     } else {
-        list_push_back(list)->f = sample;
+        pan = pan > step ? pan - step : 0;
     }
+    if (pan == graph_pan) {
+        return false;
+    }
+    graph_pan = pan;
+    return true;
+}
+
+bool
+GraphPanTime(uint64_t *time_out) {
+    if (graph_pan == 0 || graph_pan_time == 0) {
+        return false;
+    }
+    *time_out = graph_pan_time;
+    return true;
+}
+
+unsigned
+GraphZoomFactor() {
+    unsigned factor = 1;
+    for (unsigned i = 1; i <= graph_zoom; ++i) {
+        factor *= graph_history_factors[i];
+    }
+    return factor;
 }
 
 short
@@ -275,61 +709,236 @@ GraphSourceColor(Graph *self, int source) {
     return self->set_colors[source % vector_size(self->set_colors)];
 }
 
-void
-GraphDraw(Graph *self, Canvas *canvas, double *lo_out, double *hi_out) {
-#define Y(sample) (height - ((height - 0.25) * (sample)))
+/// Pixel row of a sample.  This `- 1` is specific to how all the graphs are
+/// currently used but it saves us from needing to differentiate between
+/// window space and canvas space.
+static inline double
+GraphPointY(const GraphDrawContext *restrict ctx, double sample) {
+    const double height = ctx->viewport.height;
+    const double scaled = (sample - ctx->lowest_sample) / ctx->highest_sample;
+    return ctx->top_y + (height - (height - 0.25) * scaled) * 4.0 - 1;
+}
+
+/// Fills the pixel columns from `from` on with the areas below the sources
+/// recorded in `tops`.  Each column is split at the top of every source in
+/// it and each part is filled with the color of the source above it, so the
+/// areas are stacked instead of drawn over each other.
+static void
+GraphFillColumns(Graph *self, const GraphDrawContext *ctx, size_t from) {
+    const size_t n = ctx->n_tops;
+    const long bottom = lround(ViewportBottom(ctx));
+    if (self->n_sources == 1) {
+        // Nothing to split, both columns of a cell are filled at once.
+        for (size_t x = from & ~1; x < n; x += 2) {
+            CanvasFillCellColumn(
+                ctx->canvas,
+                x / 2,
+                self->tops[x],
+                x + 1 < n ? self->tops[x + 1] : INT16_MAX,
+                bottom,
+                GraphSourceColor(self, 0)
+            );
+        }
+        return;
+    }
+    size_t *order = self->fill_order;
+    for (size_t x = from; x < n; ++x) {
+        // Sorting by insertion is linear when nothing changed since the last
+        // column, which is the common case.  Ties go to the lower source so
+        // the result doesn't depend on the column the fill started at.
+        for (size_t i = 1; i < self->n_sources; ++i) {
+            const size_t source = order[i];
+            const int16_t top = self->tops[source * n + x];
+            size_t j = i;
+            for (; j > 0; --j) {
+                const int16_t other = self->tops[order[j - 1] * n + x];
+                if (other < top || (other == top && order[j - 1] < source)) {
+                    break;
+                }
+                order[j] = order[j - 1];
+            }
+            order[j] = source;
+        }
+        for (size_t i = 0; i < self->n_sources; ++i) {
+            const long top = self->tops[order[i] * n + x];
+            if (top > bottom) {
+                break;
+            }
+            const long next = i + 1 < self->n_sources
+                                  ? self->tops[order[i + 1] * n + x]
+                                  : bottom + 1;
+            CanvasFillColumn(
+                ctx->canvas,
+                x,
+                top,
+                Min(next - 1, bottom),
+                GraphSourceColor(self, order[i])
+            );
+        }
+    }
+}
+
+typedef void (*GraphSegmentsFn)(
+    GraphDrawContext *restrict ctx,
+    const Graph *self,
+    const double *view,
+    size_t source,
+    size_t first,
+    size_t count
+);
+
+/// Defines a function drawing the segments of a source from the one ending
+/// at `first` on, `ctx` holds the point before it.  There is one of these
+/// for every kind of graph with and without fill so the segment drawing is
+/// inlined into a loop of its own instead of called through a pointer.
+#define GRAPH_SEGMENTS(name, draw)                                            \
+    static void name(                                                         \
+        GraphDrawContext *restrict ctx,                                       \
+        const Graph *self,                                                    \
+        const double *view,                                                   \
+        size_t source,                                                        \
+        size_t first,                                                         \
+        size_t count                                                          \
+    ) {                                                                       \
+        for (size_t j = first; j < count; ++j) {                              \
+            /* x2,y2 are the current point because we want x1,y1 to be */    \
+            /* the point on the left. */                                      \
+            ctx->x2 += ctx->step;                                             \
+            ctx->y2 = GraphPointY(ctx, GraphPoint(self, view, source, j));    \
+            draw(ctx);                                                        \
+            ctx->x1 = ctx->x2;                                                \
+            ctx->y1 = ctx->y2;                                                \
+        }                                                                     \
+    }
+
+GRAPH_SEGMENTS(GraphStraightSegments, DrawLine)
+GRAPH_SEGMENTS(GraphStraightFillSegments, DrawLineFill)
+GRAPH_SEGMENTS(GraphBezirSegments, DrawBezir)
+GRAPH_SEGMENTS(GraphBezirFillSegments, DrawBezirFill)
+GRAPH_SEGMENTS(GraphBlocksSegments, DrawBlocks)
+GRAPH_SEGMENTS(GraphBlocksFillSegments, DrawBlocksFill)
+#undef GRAPH_SEGMENTS
+
+static GraphSegmentsFn
+GraphKindSegmentsDrawer(Graph_Kind kind, bool fill) {
+    switch (kind) {
+    case GRAPH_KIND_STRAIGHT:
+        return fill ? GraphStraightFillSegments : GraphStraightSegments;
+    case GRAPH_KIND_BEZIR:
+        return fill ? GraphBezirFillSegments : GraphBezirSegments;
+    case GRAPH_KIND_BLOCKS:
+        return fill ? GraphBlocksFillSegments : GraphBlocksSegments;
+    }
+    __builtin_unreachable();
+}
+
+/// Gets the range the points are drawn in, filling the view first when
+/// zoomed out or panned.  Returns whether the points come from the view.
+static bool
+GraphPrepareDraw(Graph *self, double *lo_out, double *hi_out) {
     double lowest_sample, highest_sample;
+    const bool use_view = graph_zoom > 0 || graph_pan > 0;
+    if (use_view) {
+        GraphFillView(self, &lowest_sample, &highest_sample);
+    }
     if (self->fixed_range) {
         lowest_sample = self->lowest_sample;
         highest_sample = self->highest_sample;
     } else {
-        GraphGetRange(self, &lowest_sample, &highest_sample);
+        if (!use_view) {
+            GraphGetRange(self, &lowest_sample, &highest_sample);
+        }
         // FIXME: for now we don't need to scale to bottom end of the range
         // but for proper support we'd need to be able a fixed/dynamic value
         // for the start and end separately.
         lowest_sample = 0.0;
     }
+    *lo_out = lowest_sample;
+    *hi_out = highest_sample;
+    return use_view;
+}
+
+void
+GraphDraw(Graph *self, Canvas *canvas, double *lo_out, double *hi_out) {
+    double lowest_sample, highest_sample;
+    const bool use_view
+        = GraphPrepareDraw(self, &lowest_sample, &highest_sample);
+    // Every sample moves everything `scale` cells to the left, as long as
+    // nothing else changed only the new segments need to be drawn.  The last
+    // one drawn before is drawn again since its right end was cut off, except
+    // for the cell its left end shares with the one before it.
+    const size_t width = self->viewport.width;
+    const size_t top = self->viewport.y - 1;
+    const size_t added = self->rings[0].added - self->drawn_added;
+    const size_t boundary = width - Min(width, (added + 1) * self->scale);
+    bool scroll = !use_view && self->drawn_canvas == canvas
+                  && lowest_sample == self->drawn_lo
+                  && highest_sample == self->drawn_hi
+                  && (added + 1) * self->scale <= width;
+    for (size_t i = 1; scroll && i < self->n_sources; ++i) {
+        scroll = self->rings[i].added == self->rings[0].added;
+    }
+    if (scroll) {
+        CanvasScrollLeft(
+            canvas, 0, top, width, self->viewport.height, added * self->scale
+        );
+        CanvasCopyRect(
+            self->column, 0, 0, canvas, boundary, top, 1, self->viewport.height
+        );
+    } else {
+        CanvasClearRect(canvas, 0, top, width, self->viewport.height);
+    }
     GraphDrawContext ctx = {
-        canvas,
-        self->viewport,
-        self->scale,
-        self->n_sources == 1,
-        0,
-        0.0,
-        0.0,
-        0.0,
-        0.0,
+        .canvas = canvas,
+        .viewport = self->viewport,
+        .scale = self->scale,
+        .lowest_sample = lowest_sample,
+        .highest_sample = highest_sample,
+        .top_y = (self->viewport.y - 1) * 4.0,
+        .step = 2.0 * self->scale,
+        .n_tops = width * 2,
     };
-    const double scale = 2.0 * self->scale;
-    const double top_y = (self->viewport.y - 1) * 4.0;
-    const double height = self->viewport.height;
-    const DrawLineFn DrawLine = GraphKindLineDrawer(self->kind);
-    // This `- 1` is specific to how all the graphs are currently used but it
-    // saves us from needing to differentiate between window space and canvas
-    // space.
-    double scaled_sample;
+    const GraphSegmentsFn DrawSegments
+        = GraphKindSegmentsDrawer(self->kind, self->fill);
+    if (self->fill) {
+        for (size_t i = 0; i < self->n_sources * ctx.n_tops; ++i) {
+            self->tops[i] = INT16_MAX;
+        }
+    }
+    // Leftmost pixel column anything was drawn in.
+    double left = ctx.n_tops;
     for (int i = self->n_sources - 1; i >= 0; --i) {
-        List *list = self->samples[i];
-        if (list->count <= 1) {
+        const size_t count
+            = use_view ? self->view_counts[i] : self->rings[i].count;
+        if (count <= 1) {
             continue;
         }
-        scaled_sample = (list->front->f - lowest_sample) / highest_sample;
-        ctx.x1 = (double)self->viewport.width * 2.0 - (list->count - 1) * scale;
-        ctx.y1 = top_y + Y(scaled_sample) * 4.0 - 1;
+        const double *view = use_view ? self->view + i * self->capacity : NULL;
+        // Index of the right point of the first segment drawn.
+        const size_t first = scroll ? count - Min(added + 1, count - 1) : 1;
+        ctx.x1 = (double)self->viewport.width * 2.0
+                 - (count - first) * ctx.step;
+        left = Min(left, ctx.x1);
+        ctx.y1 = GraphPointY(&ctx, GraphPoint(self, view, i, first - 1));
         ctx.x2 = ctx.x1;
+        ctx.tops = self->tops + i * ctx.n_tops;
         ctx.color = GraphSourceColor(self, i);
-        for (const List_Node *it = list->front->next; it != NULL;
-             it = it->next) {
-            scaled_sample = (it->f - lowest_sample) / highest_sample;
-            // x2,y2 are the current point because we want x1,y1 to be the
-            // point on the left.
-            ctx.x2 += scale;
-            ctx.y2 = top_y + Y(scaled_sample) * 4.0 - 1;
-            DrawLine(&ctx);
-            ctx.x1 = ctx.x2;
-            ctx.y1 = ctx.y2;
-        }
+        DrawSegments(&ctx, self, view, i, first, count);
+    }
+    if (self->fill) {
+        GraphFillColumns(self, &ctx, Max(lround(left), 0L));
     }
+    if (scroll) {
+        CanvasCopyRect(
+            canvas, boundary, top, self->column, 0, 0, 1, self->viewport.height
+        );
+    }
+    // What is drawn from the view changes with the zoom and pan, so it is
+    // always drawn from scratch.
+    self->drawn_canvas = use_view ? NULL : canvas;
+    self->drawn_added = self->rings[0].added;
+    self->drawn_lo = lowest_sample;
+    self->drawn_hi = highest_sample;
     if (lo_out) {
         *lo_out = lowest_sample;
     }
@@ -338,6 +947,79 @@ GraphDraw(Graph *self, Canvas *canvas, double *lo_out, double *hi_out) {
     }
 }
 
+/// Returns the number of points all of the sources have.
+static size_t
+GraphCommonCount(
+    const Graph *self, bool use_view, size_t first, size_t end
+) {
+    size_t count = SIZE_MAX;
+    for (size_t source = first; source < end; ++source) {
+        count = Min(
+            count,
+            use_view ? self->view_counts[source] : self->rings[source].count
+        );
+    }
+    return count;
+}
+
+void
+GraphDrawHeatmap(
+    Graph *self,
+    Canvas *canvas,
+    const short *colors,
+    size_t n_colors,
+    double *lo_out,
+    double *hi_out
+) {
+    double lo, hi;
+    const bool use_view = GraphPrepareDraw(self, &lo, &hi);
+    const size_t width = self->viewport.width;
+    const size_t height = self->viewport.height;
+    const size_t top = self->viewport.y - 1;
+    CanvasClearRect(canvas, 0, top, width, height);
+    const size_t groups = Min(self->n_sources, height);
+    for (size_t group = 0; group < groups; ++group) {
+        const size_t first = group * self->n_sources / groups;
+        const size_t end = (group + 1) * self->n_sources / groups;
+        const size_t y = top + group * height / groups;
+        const size_t rows = top + (group + 1) * height / groups - y;
+        const size_t count = GraphCommonCount(self, use_view, first, end);
+        for (size_t i = 0; i < count; ++i) {
+            // Every point colors the cells of the segment ending at it.
+            const long right = width - (long)(count - 1 - i) * self->scale;
+            const long left = Max(right - (long)self->scale, 0L);
+            if (right <= 0) {
+                continue;
+            }
+            double sum = 0.0;
+            for (size_t source = first; source < end; ++source) {
+                const size_t n = use_view ? self->view_counts[source]
+                                          : self->rings[source].count;
+                const double *view
+                    = use_view ? self->view + source * self->capacity : NULL;
+                sum += GraphPoint(self, view, source, n - count + i);
+            }
+            const double level
+                = hi > lo ? (sum / (end - first) - lo) / (hi - lo) : 0.0;
+            // The lowest step is left empty so idle sources don't stand out.
+            const long step = Min(lround(level * n_colors), (long)n_colors);
+            if (step > 0) {
+                CanvasFillCells(
+                    canvas, left, y, right - left, rows, colors[step - 1]
+                );
+            }
+        }
+    }
+    // GraphDraw can't scroll what was drawn here.
+    self->drawn_canvas = NULL;
+    if (lo_out) {
+        *lo_out = lo;
+    }
+    if (hi_out) {
+        *hi_out = hi;
+    }
+}
+
 void
 GraphSetColors(Graph *self, ...) {
     va_list ap;
@@ -348,6 +1030,7 @@ GraphSetColors(Graph *self, ...) {
         vector_push(self->set_colors, color);
     }
     va_end(ap);
+    GraphInvalidate(self);
 }
 
 void
@@ -356,9 +1039,11 @@ GraphSetColorsList(Graph *self, short *colors, size_t n) {
     for (size_t i = 0; i < n; ++i) {
         vector_push(self->set_colors, colors[i]);
     }
+    GraphInvalidate(self);
 }
 
 double
 GraphLastSample(Graph *self, int source) {
-    return self->samples[source]->back->f;
+    const size_t count = self->rings[source].count;
+    return count ? GraphSample(self, source, count - 1) : 0.0;
 }
@@ -1,23 +1,102 @@
 #pragma once
 #include "canvas/canvas.h"
+#include "series.h"
 #include "stdafx.h"
 #include "vector.h"
 
 #define DEFAULT_GRAPH_SCALE 8
 
+/** Number of time axis zoom levels, level 0 are the plain samples and every
+    other one consolidates a number of rows of the level below. */
+#define GRAPH_HISTORY_LEVELS 5
+/** Rows kept for each consolidated level. */
+#define GRAPH_HISTORY_ROWS 128
+/** Number of points `GraphPan` moves by. */
+#define GRAPH_PAN_STEP 16
+
 typedef enum {
     GRAPH_KIND_STRAIGHT,
     GRAPH_KIND_BEZIR,
     GRAPH_KIND_BLOCKS,
 } Graph_Kind;
 
+/** Whether the area below the graph is filled.  When several sources are
+    filled their areas are stacked, every column is split at the highest
+    point of each source and every part gets the color of the source above
+    it. */
+typedef enum {
+    /** Only graphs with a single source are filled. */
+    GRAPH_FILL_DEFAULT,
+    GRAPH_FILL_OFF,
+    GRAPH_FILL_ON,
+} Graph_Fill;
+
 typedef struct {
     int16_t x, y, width, height;
 } Rectangle;
 
+typedef struct {
+    size_t front;
+    size_t count;
+} Graph_Deque;
+
+typedef struct {
+    /** Index of the oldest sample within the source's part of the block. */
+    size_t start;
+    size_t count;
+    /** Number of samples ever added. */
+    size_t added;
+    /** Monotonic deques of sample indices from oldest to newest, the front of
+        `maxima` is the largest sample and the front of `minima` the smallest
+        one, so the range never needs a scan. */
+    Graph_Deque maxima, minima;
+} Graph_Ring;
+
+typedef struct {
+    float min, avg, max;
+} Graph_Row;
+
+typedef struct {
+    Graph_Row rows[GRAPH_HISTORY_ROWS];
+    uint16_t start;
+    uint16_t count;
+    /** The row being consolidated from the level below, `avg` holds the sum
+        until it is complete. */
+    Graph_Row pending;
+    uint16_t pending_count;
+} Graph_Level;
+
 typedef struct {
     Graph_Kind kind;
-    List **samples;
+    /** One block with `capacity` samples for each source, every source uses
+        its part as a ring buffer described by `rings`. */
+    double *samples;
+    Graph_Ring *rings;
+    /** Storage for the deques, `capacity` indices for each of them. */
+    size_t *extrema;
+    /** Long term history, `GRAPH_HISTORY_LEVELS - 1` levels per source. */
+    Graph_Level *history;
+    /** Every sample with its time, compressed, used when panned. */
+    Series *series;
+    /** The points drawn when zoomed out or panned, laid out like `samples`. */
+    double *view;
+    size_t *view_counts;
+    /** The canvas holding what the last `GraphDraw` drew, or NULL if it needs
+        to be drawn from scratch.  Otherwise only the new segments are drawn
+        after scrolling the old ones. */
+    Canvas *drawn_canvas;
+    size_t drawn_added;
+    double drawn_lo, drawn_hi;
+    /** Keeps a column of cells that must not change while scrolling. */
+    Canvas *column;
+    /** The highest pixel of every source in each pixel column of the
+        viewport, filled graphs are drawn from these. */
+    int16_t *tops;
+    /** Sources ordered by their top in the column being filled, kept from
+        one column to the next since it rarely changes. */
+    size_t *fill_order;
+    bool fill;
+    size_t capacity;
     size_t n_sources;
     size_t max_samples;
     unsigned scale;
@@ -29,8 +108,12 @@ typedef struct {
     VECTOR(short) set_colors;
 } Graph;
 
-void
-GetGraphOptions(const char *domain, Graph_Kind *kind_out, unsigned *scale_out);
+void GetGraphOptions(
+    const char *domain,
+    Graph_Kind *kind_out,
+    unsigned *scale_out,
+    Graph_Fill *fill_out
+);
 
 void
 GraphConstruct(Graph *self, Graph_Kind kind, size_t n_sources, unsigned scale);
@@ -46,6 +129,9 @@ void GraphSetFixedRange(Graph *self, double lo, double hi);
 /** Sets the graph to use dynamic scaling, using the given increment. */
 void GraphSetDynamicRange(Graph *self, double step);
 
+/** Sets whether the area below the graph is filled. */
+void GraphSetFill(Graph *self, Graph_Fill fill);
+
 /** Sets the horizontal scaling.  If `update_max_samples` is true this set the
     the maximum number of samples based on the width of the viewport. */
 void GraphSetScale(Graph *self, unsigned scale, bool update_max_samples);
@@ -53,11 +139,40 @@ void GraphSetScale(Graph *self, unsigned scale, bool update_max_samples);
 /** Adds a sample to the source. */
 void GraphAddSample(Graph *self, size_t source, double sample);
 
-/** Draws the graph.  The highest and lowest sample from all sources is written
-    to the `lo_out` and `hi_out` parameters respectively, if they are not NULL.
- */
+/** Sets the time of the samples added from now on, in tenths of a second since
+    the epoch.  0, the default, uses the time each sample is added at, a replay
+    sets the time its frames were recorded at. */
+void GraphSetSampleTime(uint64_t time);
+
+/** Removes all samples. */
+void GraphClear(Graph *self);
+
+/** Makes the next `GraphDraw` draw everything instead of only what changed.
+    Needed when something else drew over its viewport. */
+void GraphInvalidate(Graph *self);
+
+/** Draws the graph into its viewport, replacing what was there.  The highest
+    and lowest sample from all sources is written to the `lo_out` and `hi_out`
+    parameters respectively, if they are not NULL. */
 void GraphDraw(Graph *self, Canvas *canvas, double *lo_out, double *hi_out);
 
+/** Draws the graph as a heatmap into its viewport by filling whole cells,
+    with a band of rows for each source and time on the x-axis like
+    `GraphDraw`.  Points are rounded to one of `n_colors` + 1 steps of the
+    range, the lowest one is left empty and the others use `colors` from low
+    to high.  If there are
+    more sources than rows, neighbouring sources share a row and show their
+    average.  The range is written to `lo_out` and `hi_out` like `GraphDraw`
+    does. */
+void GraphDrawHeatmap(
+    Graph *self,
+    Canvas *canvas,
+    const short *colors,
+    size_t n_colors,
+    double *lo_out,
+    double *hi_out
+);
+
 /** Overwrites the default colors for any number of sources, terminated by -1.
  */
 void GraphSetColors(Graph *self, ...);
@@ -69,5 +184,22 @@ void GraphSetColorsList(Graph *self, short *colors, size_t n);
     speified by `GraphSetColors` or the default. */
 short GraphSourceColor(Graph *self, int source);
 
-/** Returns the last sample added to the given source. */
+/** Changes the time axis zoom level of all graphs by `delta`.  Returns false
+    if it was already at the limit. */
+bool GraphZoom(int delta);
+
+/** Moves the time axis of all graphs `delta` steps into the past, or towards
+    the present if negative.  Returns false if it was already at the limit. */
+bool GraphPan(int delta);
+
+/** Writes the time of the newest point shown, in tenths of a second since the
+    epoch, if the graphs are panned.  Returns false otherwise. */
+bool GraphPanTime(uint64_t *time_out);
+
+/** Returns how many samples a single point covers at the current zoom level.
+ */
+unsigned GraphZoomFactor();
+
+/** Returns the last sample added to the given source, or 0 if there is
+    none. */
 double GraphLastSample(Graph *self, int source);
@@ -1,7 +1,9 @@
 #include "memory.h"
 #include "canvas/canvas.h"
 #include "graph.h"
+#include "procfs.h"
 #include "ps/util.h"
+#include "record.h"
 #include "util.h"
 
 IgnoreInput(Memory);
@@ -11,79 +13,177 @@ Widget mem_widget = WIDGET("memory", Memory);
 static Graph mem_graph;
 static Canvas *mem_canvas;
 
-static struct sysinfo mem_sysinfo;
+static char *mem_meminfo_path;
 static unsigned long mem_main_total;
 static unsigned long mem_swap_total;
 
+/** The values from meminfo that we use, in bytes. */
+typedef struct {
+    unsigned long total;
+    unsigned long free;
+    /** 0 if the kernel does not provide it. */
+    unsigned long available;
+    unsigned long buffers;
+    unsigned long shared;
+    unsigned long swap_total;
+    unsigned long swap_free;
+} Mem_Info;
+
+static void
+MemoryReadInfo(Mem_Info *info) {
+    static char filebuf[4096];
+    const struct {
+        const char *key;
+        unsigned long *value;
+    } fields[] = {
+        {"MemTotal:", &info->total},
+        {"MemFree:", &info->free},
+        {"MemAvailable:", &info->available},
+        {"Buffers:", &info->buffers},
+        {"Shmem:", &info->shared},
+        {"SwapTotal:", &info->swap_total},
+        {"SwapFree:", &info->swap_free},
+    };
+    int fd;
+    ssize_t s = -1;
+    memset(info, 0, sizeof(*info));
+    if ((fd = open(mem_meminfo_path, O_RDONLY)) < 0) {
+        return;
+    }
+    s = read(fd, filebuf, sizeof(filebuf) - 1);
+    close(fd);
+    filebuf[s > 0 ? s : 0] = '\0';
+
+    char *p = filebuf;
+    while (*p) {
+        for (size_t i = 0; i < countof(fields); ++i) {
+            const size_t len = strlen(fields[i].key);
+            if (strncmp(p, fields[i].key, len) == 0) {
+                p += len;
+                skipspace(&p);
+                *fields[i].value = str2u(&p) << 10;
+                break;
+            }
+        }
+        p = strchrnul(p, '\n');
+        p += *p == '\n';
+    }
+}
+
 static void
 MemoryGetTotal() {
-    sysinfo(&mem_sysinfo);
-    mem_main_total = mem_sysinfo.totalram;
-    mem_swap_total = mem_sysinfo.totalswap;
+    Mem_Info info;
+    MemoryReadInfo(&info);
+    mem_main_total = info.total;
+    mem_swap_total = info.swap_total;
 }
 
 void
-MemoryInit(WINDOW *win) {
+MemoryCollectorInit() {
+    mem_meminfo_path = Format("%s/meminfo", procfs_root);
     MemoryGetTotal();
-    MemoryDrawBorder(win);
-    mem_canvas = CanvasCreate(win);
     unsigned graph_scale = DEFAULT_GRAPH_SCALE;
     Graph_Kind graph_kind = GRAPH_KIND_STRAIGHT;
-    GetGraphOptions(mem_widget.name, &graph_kind, &graph_scale);
+    Graph_Fill graph_fill = GRAPH_FILL_DEFAULT;
+    GetGraphOptions(mem_widget.name, &graph_kind, &graph_scale, &graph_fill);
     GraphConstruct(&mem_graph, graph_kind, 2, graph_scale);
+    GraphSetFill(&mem_graph, graph_fill);
     GraphSetFixedRange(&mem_graph, 0.0, 1.0);
-    GraphSetColors(&mem_graph, theme->mem_main, theme->mem_swap, -1);
 }
 
 void
-MemoryQuit() {
+MemoryCollectorQuit() {
+    free(mem_meminfo_path);
     GraphDestroy(&mem_graph);
-    CanvasDelete(mem_canvas);
 }
 
-static unsigned long
-MemoryAvailable() {
-    static char filebuf[128];
-    int fd;
-    ssize_t s = -1;
-    if ((fd = open("/proc/meminfo", O_RDONLY)) < 0) {
-        return 0;
-    }
-    s = read(fd, filebuf, sizeof(filebuf) - 1);
-    close(fd);
-    filebuf[s > 0 ? s : 0] = '\0';
+double
+MemoryMainUsage() {
+    return GraphLastSample(&mem_graph, 0);
+}
 
-    char *p = filebuf;
-    int skiplines = 2;
-    while (skiplines) {
-        skiplines -= *p++ == '\n';
-    }
-    p += 13; /* skip "MemAvailable:" */
-    skipspace(&p);
-    return str2u(&p) << 10;
+double
+MemorySwapUsage() {
+    return GraphLastSample(&mem_graph, 1);
+}
+
+unsigned long
+MemoryMainTotal() {
+    return mem_main_total;
+}
+
+unsigned long
+MemorySwapTotal() {
+    return mem_swap_total;
+}
+
+void
+MemoryInit(WINDOW *win) {
+    MemoryCollectorInit();
+    MemoryDrawBorder(win);
+    WidgetHiddenUpdate(&mem_widget, HIDDEN_UPDATE_HISTORY);
+    mem_canvas = CanvasCreate(win);
+    GraphSetColors(&mem_graph, theme->mem_main, theme->mem_swap, -1);
+}
+
+void
+MemoryQuit() {
+    MemoryCollectorQuit();
+    CanvasDelete(mem_canvas);
 }
 
 void
 MemoryUpdate() {
-    sysinfo(&mem_sysinfo);
-    unsigned long main_avail = MemoryAvailable();
+    Mem_Info info;
+    MemoryReadInfo(&info);
     unsigned long main_used;
-    if (main_avail) {
-        main_used = mem_sysinfo.totalram - main_avail;
+    if (info.available) {
+        main_used = info.total - info.available;
     } else {
-        main_used
-            = (mem_sysinfo.totalram - mem_sysinfo.freeram
-               - mem_sysinfo.bufferram - mem_sysinfo.sharedram);
+        main_used = info.total - info.free - info.buffers - info.shared;
     }
-    unsigned long swap_used = mem_sysinfo.totalswap - mem_sysinfo.freeswap;
+    unsigned long swap_used = info.swap_total - info.swap_free;
 
     GraphAddSample(&mem_graph, 0, (double)main_used / (double)mem_main_total);
     GraphAddSample(&mem_graph, 1, (double)swap_used / (double)mem_swap_total);
 }
 
+void
+MemoryRecord(Frame *frame, bool keyframe) {
+    size_t mark;
+    if (keyframe) {
+        mark = RecordBegin(frame, RECORD_MEMORY_INFO);
+        FramePutVarint(frame, mem_main_total);
+        FramePutVarint(frame, mem_swap_total);
+        RecordEnd(frame, mark);
+    }
+    mark = RecordBegin(frame, RECORD_MEMORY);
+    FramePutRatio(frame, GraphLastSample(&mem_graph, 0));
+    FramePutRatio(frame, GraphLastSample(&mem_graph, 1));
+    RecordEnd(frame, mark);
+}
+
+void
+MemoryReplay(Frame_Reader *reader, int type) {
+    switch (type) {
+    case RECORD_REPLAY_RESET:
+        GraphClear(&mem_graph);
+        break;
+
+    case RECORD_MEMORY_INFO:
+        mem_main_total = FrameGetVarint(reader);
+        mem_swap_total = FrameGetVarint(reader);
+        break;
+
+    case RECORD_MEMORY:
+        GraphAddSample(&mem_graph, 0, FrameGetRatio(reader));
+        GraphAddSample(&mem_graph, 1, FrameGetRatio(reader));
+        break;
+    }
+}
+
 void
 MemoryDraw(WINDOW *win) {
-    CanvasClear(mem_canvas);
     GraphDraw(&mem_graph, mem_canvas, NULL, NULL);
     CanvasDraw(mem_canvas, win);
 
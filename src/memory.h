@@ -4,6 +4,18 @@
 
 extern Widget mem_widget;
 
+/** Sets up the data collection without any of the UI, `MemoryUpdate` may be
+    called after this. */
+void MemoryCollectorInit();
+void MemoryCollectorQuit();
+
+/** Returns the latest main memory and swap usage in 0~1. */
+double MemoryMainUsage();
+double MemorySwapUsage();
+/** Returns the total main memory and swap in bytes. */
+unsigned long MemoryMainTotal();
+unsigned long MemorySwapTotal();
+
 void MemoryInit(WINDOW *win);
 void MemoryQuit();
 void MemoryUpdate();
@@ -11,5 +23,7 @@ void MemoryDraw(WINDOW *win);
 void MemoryResize(WINDOW *win);
 void MemoryMinSize(int *width_return, int *height_return);
 void MemoryDrawBorder(WINDOW *win);
+void MemoryRecord(Frame *frame, bool keyframe);
+void MemoryReplay(Frame_Reader *reader, int type);
 
 unsigned long MemoryTotal();
@@ -1,7 +1,10 @@
 #include "network.h"
 #include "canvas/canvas.h"
 #include "graph.h"
+#include "procfs.h"
+#include "record.h"
 #include "util.h"
+#include <sys/stat.h>
 
 extern struct timespec interval;
 
@@ -13,12 +16,16 @@ bool net_auto_scale = false;
 
 static unsigned long net_receive_total;
 static unsigned long net_transmit_total;
+static unsigned long net_receive_period;
+static unsigned long net_transmit_period;
 
 static Canvas *net_canvas;
 
 static struct {
     char *name;
     char *rt_char;
+    unsigned long receive;
+    unsigned long transmit;
 } *net_interfaces;
 static unsigned net_interface_count;
 static double net_period;
@@ -26,113 +33,209 @@ static double net_period;
 static Graph net_recv_graph;
 static Graph net_send_graph;
 
+static bool
+NetworkIsInterface(DIR *dir, const struct dirent *entry) {
+    // Entries in class/net are symlinks to the devices, but the bonding driver
+    // adds a regular file next to them.
+    if (entry->d_name[0] == '.' || strcmp(entry->d_name, "lo") == 0) {
+        return false;
+    }
+    char *path = Format("%s/statistics", entry->d_name);
+    struct stat st;
+    bool is_interface
+        = fstatat(dirfd(dir), path, &st, 0) == 0 && S_ISDIR(st.st_mode);
+    free(path);
+    return is_interface;
+}
+
 static void
 NetworkGetInterfaces() {
-    struct ifaddrs *ifaddr = NULL, *ifa = NULL;
-    int count = 0, l = 0;
-
-    getifaddrs(&ifaddr);
+    char *base_path = Format("%s/class/net", sysfs_root);
+    DIR *dir = opendir(base_path);
+    struct dirent *entry = NULL;
+    unsigned capacity = 0;
 
-    for (ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
-        if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != AF_PACKET
-            || !strcmp(ifa->ifa_name, "lo")) {
-            continue;
-        }
-        ++count;
+    net_interfaces = NULL;
+    net_interface_count = 0;
+    if (dir == NULL) {
+        free(base_path);
+        return;
     }
-
-    net_interface_count = count;
-    net_interfaces = malloc(count * sizeof(*net_interfaces));
-
-    for (ifa = ifaddr, count = 0; ifa; ifa = ifa->ifa_next) {
-        if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != AF_PACKET
-            || !strcmp(ifa->ifa_name, "lo")) {
+    while ((entry = readdir(dir))) {
+        if (!NetworkIsInterface(dir, entry)) {
             continue;
         }
-        l = strlen(ifa->ifa_name);
-        net_interfaces[count].name = malloc(36 + l);
-        memcpy(net_interfaces[count].name, "/sys/class/net/", 15);
-        memcpy(net_interfaces[count].name + 15, ifa->ifa_name, l);
-        memcpy(net_interfaces[count].name + 15 + l, "/statistics/?x_bytes", 20);
-        net_interfaces[count].name[35 + l] = '\0';
-        net_interfaces[count].rt_char = net_interfaces[count].name + 27 + l;
-        ++count;
+        if (net_interface_count == capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            net_interfaces
+                = realloc(net_interfaces, capacity * sizeof(*net_interfaces));
+        }
+        char *name = Format(
+            "%s/%s/statistics/?x_bytes", base_path, entry->d_name
+        );
+        net_interfaces[net_interface_count].name = name;
+        // Points at the '?'.
+        net_interfaces[net_interface_count].rt_char = name + strlen(name) - 8;
+        net_interfaces[net_interface_count].receive = 0;
+        net_interfaces[net_interface_count].transmit = 0;
+        ++net_interface_count;
     }
-
-    freeifaddrs(ifaddr);
+    closedir(dir);
+    free(base_path);
 }
 
 void
-NetworkInit(WINDOW *win) {
+NetworkCollectorInit() {
     net_receive_total = 0;
     net_transmit_total = 0;
     NetworkGetInterfaces();
     net_period = (double)interval.tv_sec + interval.tv_nsec / 1.0e9;
     unsigned graph_scale = DEFAULT_GRAPH_SCALE;
     Graph_Kind graph_kind = GRAPH_KIND_BLOCKS;
-    GetGraphOptions(net_widget.name, &graph_kind, &graph_scale);
+    Graph_Fill graph_fill = GRAPH_FILL_DEFAULT;
+    GetGraphOptions(net_widget.name, &graph_kind, &graph_scale, &graph_fill);
     GraphConstruct(&net_recv_graph, graph_kind, 1, graph_scale);
-    GraphSetColors(&net_recv_graph, theme->net_receive, -1);
     GraphSetDynamicRange(&net_recv_graph, 0.1);
+    GraphSetFill(&net_recv_graph, graph_fill);
     GraphConstruct(&net_send_graph, graph_kind, 1, graph_scale);
-    GraphSetColors(&net_send_graph, theme->net_transmit, -1);
     GraphSetDynamicRange(&net_send_graph, 0.1);
+    GraphSetFill(&net_send_graph, graph_fill);
     NetworkUpdate();
-    list_clear(net_recv_graph.samples[0]);
-    list_clear(net_send_graph.samples[0]);
-    NetworkDrawBorder(win);
-    net_canvas = CanvasCreate(win);
+    GraphClear(&net_recv_graph);
+    GraphClear(&net_send_graph);
+    // The first period is everything transferred since boot.
+    net_receive_period = net_transmit_period = 0;
 }
 
 void
-NetworkQuit() {
+NetworkCollectorQuit() {
     GraphDestroy(&net_recv_graph);
     GraphDestroy(&net_send_graph);
     for (unsigned i = 0; i < net_interface_count; ++i) {
         free(net_interfaces[i].name);
     }
     free(net_interfaces);
+}
+
+void
+NetworkLastPeriod(unsigned long *receive, unsigned long *transmit) {
+    *receive = net_receive_period;
+    *transmit = net_transmit_period;
+}
+
+void
+NetworkTotals(unsigned long *receive, unsigned long *transmit) {
+    *receive = net_receive_total;
+    *transmit = net_transmit_total;
+}
+
+void
+NetworkInit(WINDOW *win) {
+    NetworkCollectorInit();
+    GraphSetColors(&net_recv_graph, theme->net_receive, -1);
+    GraphSetColors(&net_send_graph, theme->net_transmit, -1);
+    NetworkDrawBorder(win);
+    WidgetHiddenUpdate(&net_widget, HIDDEN_UPDATE_HISTORY);
+    net_canvas = CanvasCreate(win);
+}
+
+void
+NetworkQuit() {
+    NetworkCollectorQuit();
     CanvasDelete(net_canvas);
 }
 
-static inline unsigned long
-NetworkGetBytes(FILE *f) {
+static bool
+NetworkGetBytes(const char *path, unsigned long *bytes) {
+    FILE *f = fopen(path, "r");
     char buf[128];
-    assert(fgets(buf, 128, f));
-    return strtoul(buf, NULL, 10);
+    if (f == NULL) {
+        return false;
+    }
+    bool ok = fgets(buf, sizeof(buf), f) != NULL;
+    fclose(f);
+    if (ok) {
+        *bytes = strtoul(buf, NULL, 10);
+    }
+    return ok;
 }
 
 void
 NetworkUpdate() {
-    unsigned long prev_receive = net_receive_total;
-    unsigned long prev_transmit = net_transmit_total;
-    FILE *f;
-
     net_receive_total = 0;
     net_transmit_total = 0;
+    net_receive_period = 0;
+    net_transmit_period = 0;
 
-    for (unsigned i = 0; i < net_interface_count; ++i) {
+    for (unsigned i = 0; i < net_interface_count;) {
+        unsigned long receive, transmit;
         *net_interfaces[i].rt_char = 'r';
-        f = fopen(net_interfaces[i].name, "r");
-        net_receive_total += NetworkGetBytes(f);
-        fclose(f);
-
+        bool ok = NetworkGetBytes(net_interfaces[i].name, &receive);
         *net_interfaces[i].rt_char = 't';
-        f = fopen(net_interfaces[i].name, "r");
-        net_transmit_total += NetworkGetBytes(f);
-        fclose(f);
+        ok = ok && NetworkGetBytes(net_interfaces[i].name, &transmit);
+        if (!ok) {
+            // The device went away, its traffic leaves the totals without
+            // counting as a negative period.
+            free(net_interfaces[i].name);
+            net_interfaces[i] = net_interfaces[--net_interface_count];
+            continue;
+        }
+        net_receive_period += receive - net_interfaces[i].receive;
+        net_transmit_period += transmit - net_interfaces[i].transmit;
+        net_interfaces[i].receive = receive;
+        net_interfaces[i].transmit = transmit;
+        net_receive_total += receive;
+        net_transmit_total += transmit;
+        ++i;
+    }
+
+    GraphAddSample(&net_recv_graph, 0, net_receive_period * net_period);
+    GraphAddSample(&net_send_graph, 0, net_transmit_period * net_period);
+}
+
+void
+NetworkRecord(Frame *frame, bool keyframe) {
+    size_t mark = RecordBegin(frame, RECORD_NETWORK);
+    FramePutVarint(frame, net_receive_period);
+    FramePutVarint(frame, net_transmit_period);
+    RecordEnd(frame, mark);
+    if (keyframe) {
+        mark = RecordBegin(frame, RECORD_NETWORK_INFO);
+        FramePutVarint(frame, net_receive_total);
+        FramePutVarint(frame, net_transmit_total);
+        RecordEnd(frame, mark);
     }
+}
 
-    double receive_period = net_receive_total - prev_receive;
-    double transmit_period = net_transmit_total - prev_transmit;
+void
+NetworkReplay(Frame_Reader *reader, int type) {
+    switch (type) {
+    case RECORD_REPLAY_RESET:
+        GraphClear(&net_recv_graph);
+        GraphClear(&net_send_graph);
+        // The totals are restored by the keyframe the seek starts at.
+        net_receive_total = net_transmit_total = 0;
+        net_receive_period = net_transmit_period = 0;
+        break;
+
+    case RECORD_NETWORK:
+        net_receive_period = FrameGetVarint(reader);
+        net_transmit_period = FrameGetVarint(reader);
+        net_receive_total += net_receive_period;
+        net_transmit_total += net_transmit_period;
+        GraphAddSample(&net_recv_graph, 0, net_receive_period * net_period);
+        GraphAddSample(&net_send_graph, 0, net_transmit_period * net_period);
+        break;
 
-    GraphAddSample(&net_recv_graph, 0, receive_period * net_period);
-    GraphAddSample(&net_send_graph, 0, transmit_period * net_period);
+    case RECORD_NETWORK_INFO:
+        net_receive_total = FrameGetVarint(reader);
+        net_transmit_total = FrameGetVarint(reader);
+        break;
+    }
 }
 
 void
 NetworkDraw(WINDOW *win) {
-    CanvasClear(net_canvas);
     GraphDraw(&net_recv_graph, net_canvas, NULL, NULL);
     GraphDraw(&net_send_graph, net_canvas, NULL, NULL);
     CanvasDraw(net_canvas, win);
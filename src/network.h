@@ -2,6 +2,16 @@
 #include "stdafx.h"
 #include "widget.h"
 
+/** Sets up the data collection without any of the UI, `NetworkUpdate` may be
+    called after this. */
+void NetworkCollectorInit();
+void NetworkCollectorQuit();
+
+/** Gets the bytes received and transmitted during the last update. */
+void NetworkLastPeriod(unsigned long *receive, unsigned long *transmit);
+/** Gets the bytes received and transmitted since the interfaces came up. */
+void NetworkTotals(unsigned long *receive, unsigned long *transmit);
+
 void NetworkInit(WINDOW *win);
 void NetworkQuit();
 void NetworkUpdate();
@@ -9,6 +19,8 @@ void NetworkDraw(WINDOW *win);
 void NetworkResize(WINDOW *win);
 void NetworkMinSize(int *width_return, int *height_return);
 void NetworkDrawBorder(WINDOW *win);
+void NetworkRecord(Frame *frame, bool keyframe);
+void NetworkReplay(Frame_Reader *reader, int type);
 
 extern Widget net_widget;
 extern bool net_auto_scale;
@@ -0,0 +1,151 @@
+#define NCURSES_WIDECHAR 1
+#include "offscreen.h"
+#include <limits.h>
+#include <wchar.h>
+
+/** Attributes kept in ANSI dumps, everything else is dropped. */
+#define OFFSCREEN_ATTRS (A_BOLD | A_DIM | A_UNDERLINE | A_REVERSE)
+
+/** Line drawing characters of the alternate character set, the cells keep the
+    ASCII character that selects them. */
+static const char offscreen_acs[] = "jklmnqtuvwx~a`";
+static const wchar_t offscreen_acs_chars[] = L"┘┐┌└┼─├┤┴┬│·▒◆";
+
+static SCREEN *offscreen;
+static FILE *offscreen_output;
+static FILE *offscreen_input;
+
+bool
+OffscreenStart(int width, int height) {
+    setlocale(LC_ALL, "");
+    offscreen_output = fopen("/dev/null", "w");
+    offscreen_input = fopen("/dev/null", "r");
+    if (offscreen_output == NULL || offscreen_input == NULL
+        || (offscreen = newterm(
+                "xterm-256color", offscreen_output, offscreen_input
+            ))
+               == NULL) {
+        fputs("sm: could not start an offscreen terminal\n", stderr);
+        OffscreenStop();
+        return false;
+    }
+    set_term(offscreen);
+    if (width > 0 && height > 0) {
+        resize_term(height, width);
+    }
+    curs_set(FALSE);
+    // Nothing is ever typed, don't poll for it on every refresh.
+    typeahead(-1);
+    start_color();
+    use_default_colors();
+    init_pair(0, -1, -1);
+    return true;
+}
+
+void
+OffscreenStop() {
+    if (offscreen) {
+        endwin();
+        delscreen(offscreen);
+        offscreen = NULL;
+    }
+    if (offscreen_output) {
+        fclose(offscreen_output);
+        offscreen_output = NULL;
+    }
+    if (offscreen_input) {
+        fclose(offscreen_input);
+        offscreen_input = NULL;
+    }
+}
+
+/** Prints an SGR parameter selecting `color` as the fore- or background. */
+static void
+OffscreenColor(FILE *stream, short color, bool background) {
+    const int base = background ? 40 : 30;
+    if (color < 0) {
+        fprintf(stream, ";%d", base + 9);
+    } else if (color < 8) {
+        fprintf(stream, ";%d", base + color);
+    } else if (color < 16) {
+        fprintf(stream, ";%d", base + 60 + color - 8);
+    } else {
+        fprintf(stream, ";%d;5;%d", base + 8, color);
+    }
+}
+
+static void
+OffscreenStyle(FILE *stream, attr_t attrs, short pair) {
+    short fg, bg;
+    fputs("\033[0", stream);
+    if (attrs & A_BOLD) {
+        fputs(";1", stream);
+    }
+    if (attrs & A_DIM) {
+        fputs(";2", stream);
+    }
+    if (attrs & A_UNDERLINE) {
+        fputs(";4", stream);
+    }
+    if (attrs & A_REVERSE) {
+        fputs(";7", stream);
+    }
+    if (pair_content(pair, &fg, &bg) == OK) {
+        OffscreenColor(stream, fg, false);
+        OffscreenColor(stream, bg, true);
+    }
+    fputc('m', stream);
+}
+
+void
+OffscreenDump(WINDOW *win, FILE *stream, bool ansi) {
+    const int width = getmaxx(win);
+    const int height = getmaxy(win);
+    cchar_t cell;
+    wchar_t text[CCHARW_MAX + 1];
+    attr_t attrs;
+    short pair;
+    char bytes[MB_LEN_MAX];
+    for (int y = 0; y < height; ++y) {
+        attr_t last_attrs = 0;
+        short last_pair = 0;
+        for (int x = 0; x < width; ++x) {
+            if (mvwin_wch(win, y, x, &cell) == ERR
+                || getcchar(&cell, text, &attrs, &pair, NULL) == ERR) {
+                continue;
+            }
+            if (attrs & A_ALTCHARSET && text[0] > 0 && text[0] < 128) {
+                const char *acs = strchr(offscreen_acs, text[0]);
+                if (acs) {
+                    text[0] = offscreen_acs_chars[acs - offscreen_acs];
+                }
+            }
+            attrs &= OFFSCREEN_ATTRS;
+            if (ansi && (attrs != last_attrs || pair != last_pair)) {
+                OffscreenStyle(stream, attrs, pair);
+                last_attrs = attrs;
+                last_pair = pair;
+            }
+            if (text[0] == L'\0') {
+                text[0] = L' ';
+                text[1] = L'\0';
+            }
+            mbstate_t state = {0};
+            for (const wchar_t *c = text; *c; ++c) {
+                const size_t n = wcrtomb(bytes, *c, &state);
+                if (n == (size_t)-1) {
+                    fputc('?', stream);
+                    memset(&state, 0, sizeof(state));
+                } else {
+                    fwrite(bytes, 1, n, stream);
+                }
+            }
+            // The cells covered by a wide character repeat it.
+            x += Max(wcwidth(text[0]), 1) - 1;
+        }
+        if (ansi && (last_attrs != 0 || last_pair != 0)) {
+            fputs("\033[0m", stream);
+        }
+        fputc('\n', stream);
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "stdafx.h"
+
+/** Starts curses on a screen that is never shown, its output goes to
+    /dev/null so every window, the canvas and the drawing helpers work as usual
+    but only change the cells kept in memory.  A size of 0 uses the LINES and
+    COLUMNS environment variables, or 80x24.  The terminal is always
+    xterm-256color so the result does not depend on the one sm runs in.
+    Returns false if curses could not be started. */
+bool OffscreenStart(int width, int height);
+
+void OffscreenStop();
+
+/** Prints every cell of `win` to `stream`, one line per row.  With `ansi` the
+    colors and attributes of the cells are kept as SGR escape sequences.
+    Passing `curscr` after a refresh prints the whole screen. */
+void OffscreenDump(WINDOW *win, FILE *stream, bool ansi);
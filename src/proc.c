@@ -4,6 +4,8 @@
 #include "dialog.h"
 #include "input.h"
 #include "ps/ps.h"
+#include "record.h"
+#include "replay.h"
 #include "sm.h"
 #include "util.h"
 
@@ -19,6 +21,8 @@ static unsigned long proc_time_passed;
 static pthread_mutex_t proc_data_mutex;
 static int current_sorting_mode = PS_SORT_CPU_DESCENDING;
 static size_t proc_count;
+/** Set when the process list was updated and not recorded yet. */
+static bool proc_record_pending;
 
 static unsigned proc_cursor;
 static pid_t proc_cursor_pid;
@@ -127,6 +131,13 @@ DrawHeader(WINDOW *win) {
     wattroff(win, A_BOLD | COLOR_PAIR(theme->proc_header));
 }
 
+/** The first process of a view that ends at the last one.  A replay starts out
+    with fewer processes than fit into the view, or none at all. */
+static inline unsigned
+ProcLastViewBegin() {
+    return proc_count > proc_view_size ? proc_count - proc_view_size : 0;
+}
+
 /** Sets the cursor to the given process index and adjusts the view if needed.
     If FROM_USER is true and the same process is selected twice the cursor
     becomes sticky.  Therefor FROM_USER doesn't strictly mean just that the
@@ -142,7 +153,7 @@ ProcSetCursor(unsigned cursor, bool from_user) {
     }
     // Bottom
     else if (cursor >= proc_count - lines_before) {
-        proc_view_begin = proc_count - proc_view_size;
+        proc_view_begin = ProcLastViewBegin();
     }
     // Scrolling up
     else if (cursor < proc_cursor && cursor < proc_view_begin + lines_before) {
@@ -153,14 +164,17 @@ ProcSetCursor(unsigned cursor, bool from_user) {
              && cursor >= proc_view_begin + proc_view_size - lines_before) {
         proc_view_begin = cursor - proc_view_size + lines_before + 1;
     }
-    if (proc_view_begin + proc_view_size > proc_count) {
-        proc_view_begin = proc_count - proc_view_size;
+    if (proc_view_begin > ProcLastViewBegin()) {
+        proc_view_begin = ProcLastViewBegin();
     }
     if (from_user) {
         proc_sticky = proc_cursor == cursor;
     }
     proc_cursor = cursor;
-    proc_cursor_pid = ps_get_procs()[cursor]->pid;
+    // Only a replay can have no processes at all, until its first frame.
+    if (proc_count) {
+        proc_cursor_pid = ps_get_procs()[cursor]->pid;
+    }
 }
 
 /** Re-sets the cursor position to point to its last process id. */
@@ -170,7 +184,8 @@ ProcUpdateCursor() {
     VECTOR(Proc_Data *) procs = ps_get_procs();
     for (unsigned i = 0; i < (unsigned)vector__size(procs); ++i) {
         if (procs[i]->pid == proc_cursor_pid) {
-            proc_view_begin = Max(0u, i - cursor_position_in_view);
+            proc_view_begin
+                = (unsigned)Max(0, (int)i - (int)cursor_position_in_view);
             ProcSetCursor(i, false);
             break;
         }
@@ -221,9 +236,8 @@ ProcFitView() {
         ProcSetViewSize(Min(view_space, proc_count));
     }
     // Move view forward if it goes over the end of the process list
-    const unsigned view_end = proc_view_begin + proc_view_size;
-    if (view_end > proc_count) {
-        proc_view_begin = proc_count - proc_view_size;
+    if (proc_view_begin > ProcLastViewBegin()) {
+        proc_view_begin = ProcLastViewBegin();
     }
 }
 
@@ -232,7 +246,7 @@ ProcUpdateProcesses() {
     VECTOR(Proc_Data *) procs = ps_get_procs();
     proc_count = vector_size(procs);
     const unsigned cursor_position_in_view = proc_cursor - proc_view_begin;
-    if (proc_sticky) {
+    if (proc_sticky && proc_cursor < proc_count) {
         proc_cursor_pid = ps_get_procs()[proc_cursor]->pid;
     }
     for (size_t i = 0; i < proc_count; ++i) {
@@ -251,7 +265,7 @@ ProcUpdateProcesses() {
     }
 
     if (proc_cursor >= proc_count) {
-        ProcSetCursor(proc_count - 1, false);
+        ProcSetCursor(proc_count ? proc_count - 1 : 0, false);
     }
 
     proc_search_show = true;
@@ -259,19 +273,35 @@ ProcUpdateProcesses() {
 }
 
 void
-ProcInit(WINDOW *win) {
-    ProcSetPrefixes();
+ProcCollectorInit() {
     proc_time_passed = 1001;
-    DrawWindow(win, "Processes");
-    DrawHeader(win);
     pthread_mutex_init(&proc_data_mutex, NULL);
-    ps_init();
+    if (ReplayActive()) {
+        ps_init_feed();
+    } else {
+        ps_init();
+    }
     if (proc_forest) {
         ps_toggle_forest();
     }
     if (proc_kthreads) {
         ps_toggle_kthreads();
     }
+    proc_record_pending = true;
+}
+
+void
+ProcCollectorQuit() {
+    ps_quit();
+    pthread_mutex_destroy(&proc_data_mutex);
+}
+
+void
+ProcInit(WINDOW *win) {
+    ProcSetPrefixes();
+    DrawWindow(win, "Processes");
+    DrawHeader(win);
+    ProcCollectorInit();
     proc_view_begin = proc_cursor = 0;
     ProcSetViewSize(getmaxy(win) - 3);
     ProcUpdateProcesses();
@@ -285,8 +315,7 @@ ProcInit(WINDOW *win) {
 
 void
 ProcQuit() {
-    ps_quit();
-    pthread_mutex_destroy(&proc_data_mutex);
+    ProcCollectorQuit();
 }
 
 void
@@ -298,7 +327,115 @@ ProcUpdate() {
     proc_time_passed = 0;
     pthread_mutex_lock(&proc_data_mutex);
     ps_update();
-    ProcUpdateProcesses();
+    // Without a window only the collector is set up, see `ProcCollectorInit`.
+    if (proc_widget.win) {
+        ProcUpdateProcesses();
+    }
+    proc_record_pending = true;
+    pthread_mutex_unlock(&proc_data_mutex);
+}
+
+typedef struct {
+    Frame *frame;
+    bool keyframe;
+} Proc_Record_State;
+
+static void
+ProcRecordInfo(Proc_Data *proc, void *arg) {
+    const Proc_Record_State *state = arg;
+    if (proc->recorded && proc->recorded_parent == proc->parent
+        && !state->keyframe) {
+        return;
+    }
+    proc->recorded = true;
+    proc->recorded_parent = proc->parent;
+    const size_t mark = RecordBegin(state->frame, RECORD_PROC_INFO);
+    FramePutVarint(state->frame, proc->pid);
+    FramePutVarint(state->frame, proc->parent);
+    FramePutVarint(state->frame, proc->start_time);
+    FramePutVarint(state->frame, ps_proc_cpu_time(proc));
+    FramePutU8(state->frame, proc->command_line.from_comm);
+    FramePutString(state->frame, proc->command_line.str);
+    RecordEnd(state->frame, mark);
+}
+
+static void
+ProcRecordSample(Proc_Data *proc, void *arg) {
+    Frame *frame = arg;
+    FramePutVarint(frame, proc->pid);
+    FramePutVarint(frame, ps_proc_cpu_delta(proc));
+    FramePutVarint(frame, proc->memory);
+}
+
+void
+ProcRecord(Frame *frame, bool keyframe) {
+    // The process list is only updated every other second, in between there is
+    // nothing new unless a keyframe needs the full list.
+    if (!proc_record_pending && !keyframe) {
+        return;
+    }
+    pthread_mutex_lock(&proc_data_mutex);
+    Proc_Record_State state = {frame, keyframe};
+    // Exited processes are not recorded explicitly, they are simply missing
+    // from the next sample.
+    ps_for_each(ProcRecordInfo, &state);
+    const size_t mark = RecordBegin(frame, RECORD_PROC);
+    FramePutVarint(frame, ps_cpu_delta());
+    FramePutVarint(frame, ps_total_memory());
+    FramePutVarint(frame, ps_proc_count());
+    ps_for_each(ProcRecordSample, frame);
+    RecordEnd(frame, mark);
+    proc_record_pending = false;
+    pthread_mutex_unlock(&proc_data_mutex);
+}
+
+static void
+ProcReplayInfo(Frame_Reader *reader) {
+    const pid_t pid = FrameGetVarint(reader);
+    const pid_t parent = FrameGetVarint(reader);
+    const unsigned long start_time = FrameGetVarint(reader);
+    const unsigned long cpu_time = FrameGetVarint(reader);
+    const bool from_comm = FrameGetU8(reader);
+    char *command_line = FrameGetString(reader);
+    ps_feed_info(pid, parent, start_time, cpu_time, from_comm, command_line);
+    free(command_line);
+}
+
+static void
+ProcReplaySample(Frame_Reader *reader) {
+    const unsigned long cpu_delta = FrameGetVarint(reader);
+    const unsigned long total_memory = FrameGetVarint(reader);
+    size_t count = FrameGetVarint(reader);
+    ps_feed_begin(cpu_delta, total_memory);
+    while (count-- && !reader->error) {
+        const pid_t pid = FrameGetVarint(reader);
+        const unsigned long cpu = FrameGetVarint(reader);
+        const unsigned long memory = FrameGetVarint(reader);
+        ps_feed_sample(pid, cpu, memory);
+    }
+    ps_feed_end();
+}
+
+void
+ProcReplay(Frame_Reader *reader, int type) {
+    pthread_mutex_lock(&proc_data_mutex);
+    switch (type) {
+    case RECORD_REPLAY_RESET:
+        ps_feed_clear();
+        ProcUpdateProcesses();
+        break;
+
+    case RECORD_PROC_INFO:
+        ProcReplayInfo(reader);
+        break;
+
+    case RECORD_PROC:
+        ProcReplaySample(reader);
+        ProcUpdateProcesses();
+        // The view was sized while the list was still empty.
+        ProcFitView();
+        break;
+    }
     pthread_mutex_unlock(&proc_data_mutex);
 }
 
@@ -442,6 +579,9 @@ ProcDraw(WINDOW *win) {
 
 void
 ProcResize(WINDOW *win) {
+    // This is also how we get shown again after being hidden by the layout, in
+    // which case the process list has not been updated in a while.
+    proc_time_passed = 2000;
     wclear(win);
     DrawHeader(win);
     ProcSetViewSize(getmaxy(win) - 3 - proc_search_active);
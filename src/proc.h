@@ -11,6 +11,11 @@ extern unsigned proc_scroll_speed;
 
 extern Widget proc_widget;
 
+/** Sets up the process list without any of the UI, `ProcUpdate` and
+    `ProcRecord` may be called after this. */
+void ProcCollectorInit();
+void ProcCollectorQuit();
+
 void ProcInit(WINDOW *win);
 void ProcQuit();
 void ProcUpdate();
@@ -20,6 +25,8 @@ void ProcMinSize(int *width_return, int *height_return);
 bool ProcHandleInput(int key);
 void ProcHandleMouse(Mouse_Event *event);
 void ProcDrawBorder(WINDOW *win);
+void ProcRecord(Frame *frame, bool keyframe);
+void ProcReplay(Frame_Reader *reader, int type);
 
 void ProcCursorUp(unsigned count);
 void ProcCursorDown(unsigned count);
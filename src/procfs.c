@@ -0,0 +1,15 @@
+#include "procfs.h"
+
+const char *procfs_root = "/proc";
+const char *sysfs_root = "/sys";
+
+void
+ProcfsInit() {
+    const char *s;
+    if ((s = getenv("SM_PROC_ROOT")) && *s) {
+        procfs_root = s;
+    }
+    if ((s = getenv("SM_SYS_ROOT")) && *s) {
+        sysfs_root = s;
+    }
+}
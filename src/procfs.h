@@ -0,0 +1,14 @@
+#pragma once
+#include "stdafx.h"
+
+/** Directory procfs is read from, "/proc" unless overridden by `SM_PROC_ROOT`
+    or `--proc-root`. */
+extern const char *procfs_root;
+
+/** Directory sysfs is read from, "/sys" unless overridden by `SM_SYS_ROOT` or
+    `--sys-root`. */
+extern const char *sysfs_root;
+
+/** Applies the environment variables, this must be called before parsing the
+    command line so the options take precedence. */
+void ProcfsInit();
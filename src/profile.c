@@ -0,0 +1,216 @@
+#include "profile.h"
+#include "sm.h"
+#include "util.h"
+
+// name + 6 durations + borders and padding
+#define PROFILE_NAME_WIDTH 12
+#define PROFILE_COLUMN_WIDTH 8
+#define PROFILE_WIDTH (PROFILE_NAME_WIDTH + 6 * PROFILE_COLUMN_WIDTH + 4)
+
+static Profile_Timer profile_timers[PROFILE_MAX_TIMERS];
+static int profile_timer_count = 0;
+
+static WINDOW *profile_win = NULL;
+
+static uint64_t profile_last_wall = 0;
+static uint64_t profile_last_cpu = 0;
+static double profile_cpu_usage = 0.0;
+
+static uint64_t
+ProfileClock(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+uint64_t
+ProfileNow() {
+    return ProfileClock(CLOCK_MONOTONIC);
+}
+
+static unsigned
+ProfileBucket(uint64_t ns) {
+    if (ns < PROFILE_SUB_BUCKETS) {
+        return ns;
+    }
+    const unsigned msb = 63 - __builtin_clzll(ns);
+    const unsigned shift = msb - PROFILE_SUB_BUCKET_BITS;
+    return ((shift + 1) << PROFILE_SUB_BUCKET_BITS)
+           | ((ns >> shift) & (PROFILE_SUB_BUCKETS - 1));
+}
+
+/** Returns the largest value that falls into the given bucket. */
+static uint64_t
+ProfileBucketLimit(unsigned bucket) {
+    if (bucket < PROFILE_SUB_BUCKETS) {
+        return bucket;
+    }
+    const unsigned shift = (bucket >> PROFILE_SUB_BUCKET_BITS) - 1;
+    const uint64_t mantissa
+        = (bucket & (PROFILE_SUB_BUCKETS - 1)) | PROFILE_SUB_BUCKETS;
+    return (mantissa << shift) + ((1UL << shift) - 1);
+}
+
+void
+ProfileRecord(Profile_Histogram *self, uint64_t ns) {
+    ++self->buckets[ProfileBucket(ns)];
+    ++self->count;
+    if (ns > self->max) {
+        self->max = ns;
+    }
+}
+
+uint64_t
+ProfilePercentile(const Profile_Histogram *self, double p) {
+    if (self->count == 0) {
+        return 0;
+    }
+    const uint64_t target = Max((uint64_t)ceil(p * self->count), 1UL);
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < PROFILE_BUCKETS; ++i) {
+        seen += self->buckets[i];
+        if (seen >= target) {
+            return Min(ProfileBucketLimit(i), self->max);
+        }
+    }
+    return self->max;
+}
+
+Profile_Timer *
+ProfileTimer(const char *name) {
+    for (int i = 0; i < profile_timer_count; ++i) {
+        if (strcmp(profile_timers[i].name, name) == 0) {
+            return &profile_timers[i];
+        }
+    }
+    assert(profile_timer_count < PROFILE_MAX_TIMERS);
+    Profile_Timer *timer = &profile_timers[profile_timer_count++];
+    memset(timer, 0, sizeof(*timer));
+    timer->name = name;
+    return timer;
+}
+
+static void
+ProfilePrintDuration(WINDOW *win, uint64_t ns) {
+    if (ns < 1000) {
+        wprintw(win, "%5uns", (unsigned)ns);
+    } else if (ns < 1000000) {
+        wprintw(win, "%5.1fµs", ns / 1e3);
+    } else if (ns < 1000000000) {
+        wprintw(win, "%5.1fms", ns / 1e6);
+    } else {
+        wprintw(win, "%5.1fs ", ns / 1e9);
+    }
+}
+
+static void
+ProfilePrintHistogram(WINDOW *win, const Profile_Histogram *h) {
+    if (h->count == 0) {
+        wprintw(win, "%7s %7s %7s ", "-", "-", "-");
+        return;
+    }
+    ProfilePrintDuration(win, ProfilePercentile(h, 0.5));
+    waddch(win, ' ');
+    ProfilePrintDuration(win, ProfilePercentile(h, 0.99));
+    waddch(win, ' ');
+    ProfilePrintDuration(win, h->max);
+    waddch(win, ' ');
+}
+
+/** Returns the resident set size of this process in bytes. */
+static size_t
+ProfileSelfRss() {
+    // statm is "size resident ...", in pages.
+    char *p = ReadSmallFile("/proc/self/statm", false);
+    strtoul(p, &p, 10);
+    return strtoul(p, NULL, 10) * sysconf(_SC_PAGESIZE);
+}
+
+static void
+ProfileUpdateSelfUsage() {
+    const uint64_t wall = ProfileNow();
+    const uint64_t cpu = ProfileClock(CLOCK_PROCESS_CPUTIME_ID);
+    if (profile_last_wall && wall > profile_last_wall) {
+        profile_cpu_usage = (double)(cpu - profile_last_cpu)
+                            / (double)(wall - profile_last_wall);
+    }
+    profile_last_wall = wall;
+    profile_last_cpu = cpu;
+}
+
+static void
+ProfileDraw(void *unused) {
+    (void)unused;
+    const int height = profile_timer_count + 5;
+    if (height > LINES || PROFILE_WIDTH > COLS) {
+        return;
+    }
+    if (profile_win == NULL) {
+        profile_win = newwin(height, PROFILE_WIDTH, 0, 0);
+    } else {
+        wresize(profile_win, height, PROFILE_WIDTH);
+    }
+    mvwin(profile_win, 1, COLS - PROFILE_WIDTH - 1);
+    werase(profile_win);
+    DrawWindow(profile_win, "Profile");
+
+    wattron(profile_win, A_BOLD);
+    mvwprintw(
+        profile_win,
+        1,
+        2,
+        "%-*s%-*s%s",
+        PROFILE_NAME_WIDTH,
+        "",
+        3 * PROFILE_COLUMN_WIDTH,
+        "Update",
+        "Draw"
+    );
+    mvwprintw(profile_win, 2, 2, "%-*s", PROFILE_NAME_WIDTH, "Widget");
+    for (int i = 0; i < 2; ++i) {
+        waddstr(profile_win, "    p50     p99     max ");
+    }
+    wattroff(profile_win, A_BOLD);
+
+    for (int i = 0; i < profile_timer_count; ++i) {
+        const Profile_Timer *timer = &profile_timers[i];
+        mvwprintw(
+            profile_win,
+            3 + i,
+            2,
+            "%-*.*s",
+            PROFILE_NAME_WIDTH,
+            PROFILE_NAME_WIDTH - 1,
+            timer->name
+        );
+        ProfilePrintHistogram(profile_win, &timer->update);
+        ProfilePrintHistogram(profile_win, &timer->draw);
+    }
+
+    ProfileUpdateSelfUsage();
+    wmove(profile_win, height - 2, 2);
+    waddstr(profile_win, "RSS ");
+    FormatSize(profile_win, ProfileSelfRss(), false);
+    wprintw(profile_win, "   CPU %.1f%%", profile_cpu_usage * 100.0);
+    wrefresh(profile_win);
+}
+
+void
+ProfileToggle() {
+    pthread_mutex_lock(&draw_mutex);
+    const bool visible = DrawOverlay == ProfileDraw;
+    if (visible) {
+        DrawOverlay = NULL;
+        overlay_data = NULL;
+        delwin(profile_win);
+        profile_win = NULL;
+    } else if (DrawOverlay == NULL) {
+        profile_last_wall = 0;
+        DrawOverlay = ProfileDraw;
+        overlay_data = NULL;
+    }
+    pthread_mutex_unlock(&draw_mutex);
+    if (visible) {
+        ungetch(KEY_REFRESH);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "stdafx.h"
+
+/** Every power of two gets split into this many linear buckets. */
+#define PROFILE_SUB_BUCKET_BITS 2
+#define PROFILE_SUB_BUCKETS (1 << PROFILE_SUB_BUCKET_BITS)
+#define PROFILE_BUCKETS (64 << PROFILE_SUB_BUCKET_BITS)
+
+#define PROFILE_MAX_TIMERS 16
+
+/** Log-bucketed histogram of durations in nanoseconds. */
+typedef struct {
+    uint32_t buckets[PROFILE_BUCKETS];
+    uint64_t count;
+    uint64_t max;
+} Profile_Histogram;
+
+/** Update and draw timings of a single widget. */
+typedef struct {
+    const char *name;
+    Profile_Histogram update;
+    Profile_Histogram draw;
+} Profile_Timer;
+
+/** Returns the current CLOCK_MONOTONIC time in nanoseconds. */
+uint64_t ProfileNow();
+
+/** Adds a duration to the histogram, callers hold `draw_mutex` since the
+    overlay reads the histograms while drawing. */
+void ProfileRecord(Profile_Histogram *self, uint64_t ns);
+
+/** Returns an upper bound for the given percentile (0.0~1.0) of the recorded
+    durations, the result is exact for the maximum. */
+uint64_t ProfilePercentile(const Profile_Histogram *self, double p);
+
+/** Gets the timer with the given name, creating it if it does not exist yet.
+    Timers are shown in the overlay in the order they were created. */
+Profile_Timer *ProfileTimer(const char *name);
+
+/** Shows or hides the profiling overlay. */
+void ProfileToggle();
@@ -24,6 +24,7 @@ commandline_get_command_range(
 void
 commandline_from_cmdline(Command_Line *self, File_Content content) {
     self->data = malloc((content.size + 1) * sizeof(chtype));
+    self->from_comm = false;
     chtype *writeptr = self->data;
     char c;
     int command_start = 0, command_end = 0;
@@ -69,6 +70,7 @@ void
 commandline_from_comm(Command_Line *self, File_Content content) {
     self->data = malloc((content.size + 3) * sizeof(chtype));
     self->command = self->data;
+    self->from_comm = true;
     chtype *writeptr = self->data;
     *writeptr++ = '[' | COLOR_PAIR(theme->proc_path);
     for (int i = 0; i < content.size; ++i) {
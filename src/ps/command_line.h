@@ -2,7 +2,7 @@
 #include "../stdafx.h"
 #include "util.h"
 
-#define COMMANDLINE_ZEROED ((Command_Line){NULL, NULL, NULL})
+#define COMMANDLINE_ZEROED ((Command_Line){NULL, NULL, NULL, false})
 
 typedef struct {
     /** string for searching */
@@ -11,6 +11,8 @@ typedef struct {
     chtype *data;
     /** points into `data`, skipping the path of the program */
     chtype *command;
+    /** whether this was created from `comm` instead of `cmdline` */
+    bool from_comm;
 } Command_Line;
 
 /** Initializes the command line with the data from the `cmdline` file. */
@@ -1,5 +1,6 @@
 #include "globals.h"
 
+int procfs_fd;
 unsigned page_shift_amount;
 Proc_Map procs;
 uint8_t current_generation;
@@ -6,6 +6,9 @@
 
 #define INVALID_GENERATION 0
 
+/** The procfs root directory, all process information is read relative to
+    it. */
+extern int procfs_fd;
 /** Value to left-shift a page count with to get KB. */
 extern unsigned page_shift_amount;
 /** The internal process record.  This owns the process information, whereas
@@ -22,3 +22,15 @@ jiffy_list_period(Jiffy_List *self) {
     unsigned long last = self->data[IDX(self->begin + 1)];
     return first - last;
 }
+
+unsigned long
+jiffy_list_last(const Jiffy_List *self) {
+    return self->data[self->begin];
+}
+
+unsigned long
+jiffy_list_last_period(const Jiffy_List *self) {
+    const unsigned previous
+        = self->begin ? self->begin - 1 : JIFFY_LIST_SIZE - 1;
+    return self->data[self->begin] - self->data[previous];
+}
@@ -17,3 +17,9 @@ void jiffy_list_push(Jiffy_List *self, unsigned long sample);
 
 /** Returns the jiffies between the first and last sample. */
 unsigned long jiffy_list_period(Jiffy_List *self);
+
+/** Returns the most recent sample. */
+unsigned long jiffy_list_last(const Jiffy_List *self);
+
+/** Returns the jiffies between the two most recent samples. */
+unsigned long jiffy_list_last_period(const Jiffy_List *self);
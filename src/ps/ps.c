@@ -1,4 +1,5 @@
 #include "ps.h"
+#include "../procfs.h"
 #include "globals.h"
 #include "proc_map.h"
 #include "read_stat.h"
@@ -10,6 +11,11 @@
 
 static Proc_Data *add_or_update(pid_t pid, bool force);
 
+/** Whether the data comes from the `ps_feed_*` functions instead of procfs. */
+static bool feeding = false;
+/** Set when a fed process was added or changed its parent. */
+static bool feed_relink = false;
+
 /** Checks if the name of a directory entry looks like a process ID. */
 static bool
 is_pid_dir(const struct dirent *entry) {
@@ -41,6 +47,7 @@ new_process(
     process->tree_level = 0;
     process->tree_folded = false;
     process->search_match = false;
+    process->recorded = false;
 
     if (stat.parent) {
         Proc_Data *parent = add_or_update(stat.parent, true);
@@ -61,9 +68,9 @@ new_process(
     `update_process` and `new_process` which are called by this function. */
 static Proc_Data *
 add_or_update(pid_t pid, bool force) {
-    char pathname[6 + MAX_PID_LEN + 1] = "/proc/";
-    snprintf(pathname + 6, MAX_PID_LEN + 1, "%d", pid);
-    int dir_fd = open(pathname, O_RDONLY | O_DIRECTORY);
+    char pathname[MAX_PID_LEN + 1];
+    snprintf(pathname, sizeof(pathname), "%d", pid);
+    int dir_fd = openat(procfs_fd, pathname, O_RDONLY | O_DIRECTORY);
     Proc_Map_Insert_Result insert_result;
     File_Content cmdline = read_entire_file(dir_fd, "cmdline");
     Command_Line command_line;
@@ -102,8 +109,11 @@ add_or_update(pid_t pid, bool force) {
 static void
 update_procs() {
     struct dirent *entry;
-    DIR *proc_dir = opendir("/proc");
+    DIR *proc_dir = opendir(procfs_root);
     char *name;
+    if (proc_dir == NULL) {
+        return;
+    }
     while ((entry = readdir(proc_dir))) {
         if (is_pid_dir(entry)) {
             name = entry->d_name;
@@ -162,8 +172,9 @@ proc_data_remove(Proc_Data *d) {
     }
 }
 
-void
-ps_init() {
+/** Sets up everything but the process data. */
+static void
+ps_construct() {
     // For memory info in /proc/[pid]/stat, need to translate from pages to KB.
     const unsigned page_to_bytes_shift
         = __builtin_ctz((unsigned)sysconf(_SC_PAGESIZE));
@@ -171,17 +182,33 @@ ps_init() {
     proc_map_construct(
         &procs, proc_data_alloc, proc_data_free, proc_data_remove
     );
-    jiffy_list_construct(&cpu_times, get_total_cpu());
     current_generation = INVALID_GENERATION + 1;
-    mem_total = get_total_memory();
     forest = false;
     show_kthreads = false;
     sum_children = true;
     sorting_mode = PS_SORT_CPU_DESCENDING;
     sorted_procs = vector_create(Proc_Data *, 50);
+}
+
+void
+ps_init() {
+    procfs_fd = open(procfs_root, O_RDONLY | O_DIRECTORY);
+    ps_construct();
+    jiffy_list_construct(&cpu_times, get_total_cpu());
+    mem_total = get_total_memory();
+    feeding = false;
     ps_update();
 }
 
+void
+ps_init_feed() {
+    procfs_fd = -1;
+    ps_construct();
+    jiffy_list_construct(&cpu_times, 0);
+    mem_total = 0;
+    feeding = true;
+}
+
 /** Returns a list of processes without parents.  This returns a reference to
     an internal vector which is leaked when the program terminates. */
 static VECTOR(Proc_Data *) ps_get_toplevel() {
@@ -296,12 +323,18 @@ ps_sort_procs() {
     }
 }
 
-void
-ps_update() {
+/** Starts a new generation, processes not seen during it are erased. */
+static void
+next_generation() {
     ++current_generation;
     if (current_generation == INVALID_GENERATION) {
         ++current_generation;
     }
+}
+
+void
+ps_update() {
+    next_generation();
     update_procs();
     proc_map_erase_outdated(&procs, current_generation);
     jiffy_list_push(&cpu_times, get_total_cpu());
@@ -325,7 +358,10 @@ ps_toggle_forest() {
 void
 ps_toggle_kthreads() {
     show_kthreads = !show_kthreads;
-    ps_update();
+    // Fed data can't be filtered after the fact.
+    if (!feeding) {
+        ps_update();
+    }
     ps_sort_procs();
 }
 
@@ -339,6 +375,127 @@ void
 ps_quit() {
     vector_free(sorted_procs);
     proc_map_destruct(&procs);
+    if (procfs_fd >= 0) {
+        close(procfs_fd);
+    }
+}
+
+/** Initializes the command line of a fed process.  Arguments can't be told
+    apart from spaces within them anymore, each space separates arguments. */
+static void
+feed_command_line(Command_Line *self, bool from_comm, const char *str) {
+    File_Content content;
+    content.size = strlen(str);
+    content.data = strdup(str);
+    if (from_comm) {
+        commandline_from_comm(self, content);
+    } else {
+        for (char *p = content.data; *p; ++p) {
+            if (*p == ' ') {
+                *p = '\0';
+            }
+        }
+        commandline_from_cmdline(self, content);
+    }
+    free(content.data);
+}
+
+void
+ps_feed_info(
+    pid_t pid,
+    pid_t parent,
+    unsigned long start_time,
+    unsigned long cpu_time,
+    bool from_comm,
+    const char *command_line
+) {
+    Proc_Map_Insert_Result insert_result = proc_map_insert_or_get(&procs, pid);
+    Proc_Data *process = insert_result.value;
+    if (!insert_result.is_new) {
+        if (process->start_time == start_time) {
+            if (process->parent != parent) {
+                process->parent = parent;
+                feed_relink = true;
+            }
+            return;
+        }
+        // The PID got reused, the old process is replaced in place.
+        proc_data_remove(process);
+        commandline_free(&process->command_line);
+        vector_clear(process->children);
+    }
+    *insert_result.generation = INVALID_GENERATION;
+    process->pid = pid;
+    process->parent = parent;
+    jiffy_list_construct(&process->cpu_times, cpu_time);
+    process->start_time = start_time;
+    process->memory = 0;
+    feed_command_line(&process->command_line, from_comm, command_line);
+    process->tree_level = 0;
+    process->tree_folded = false;
+    process->search_match = false;
+    process->recorded = false;
+    feed_relink = true;
+}
+
+void
+ps_feed_begin(unsigned long cpu_delta, unsigned long total_memory) {
+    next_generation();
+    jiffy_list_push(&cpu_times, jiffy_list_last(&cpu_times) + cpu_delta);
+    mem_total = total_memory;
+}
+
+void
+ps_feed_sample(pid_t pid, unsigned long cpu_delta, unsigned long memory) {
+    Proc_Map_Insert_Result insert_result;
+    if (proc_map_get(&procs, pid) == NULL) {
+        return;
+    }
+    insert_result = proc_map_insert_or_get(&procs, pid);
+    *insert_result.generation = current_generation;
+    Proc_Data *process = insert_result.value;
+    jiffy_list_push(
+        &process->cpu_times, jiffy_list_last(&process->cpu_times) + cpu_delta
+    );
+    process->memory = memory;
+}
+
+/** Rebuilds the children of all processes from their parent IDs. */
+static void
+feed_link_children() {
+    proc_map_for_each(&procs) {
+        vector_clear(it->data->children);
+    }
+    proc_map_for_each(&procs) {
+        Proc_Data *process = it->data;
+        Proc_Data *parent;
+        if (process->parent == 0) {
+            continue;
+        }
+        if ((parent = proc_map_get(&procs, process->parent))) {
+            vector_push(parent->children, process);
+        } else {
+            process->parent = 0;
+        }
+    }
+}
+
+void
+ps_feed_end() {
+    proc_map_erase_outdated(&procs, current_generation);
+    if (feed_relink) {
+        feed_link_children();
+        feed_relink = false;
+    }
+    ps_sort_procs();
+}
+
+void
+ps_feed_clear() {
+    next_generation();
+    proc_map_erase_outdated(&procs, current_generation);
+    jiffy_list_construct(&cpu_times, 0);
+    vector_clear(sorted_procs);
 }
 
 void
@@ -362,3 +519,30 @@ unsigned long
 ps_total_memory() {
     return mem_total;
 }
+
+void
+ps_for_each(void (*fn)(Proc_Data *proc, void *arg), void *arg) {
+    proc_map_for_each(&procs) {
+        fn(it->data, arg);
+    }
+}
+
+size_t
+ps_proc_count() {
+    return procs.size;
+}
+
+unsigned long
+ps_cpu_delta() {
+    return jiffy_list_last_period(&cpu_times);
+}
+
+unsigned long
+ps_proc_cpu_time(const Proc_Data *proc) {
+    return jiffy_list_last(&proc->cpu_times);
+}
+
+unsigned long
+ps_proc_cpu_delta(const Proc_Data *proc) {
+    return jiffy_list_last_period(&proc->cpu_times);
+}
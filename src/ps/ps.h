@@ -26,6 +26,12 @@ typedef struct Proc_Data {
     bool tree_folded;
     /*** Extra data ***/
     bool search_match;
+    /** Whether the recorder has written the static information (parent,
+        command line) yet. */
+    bool recorded;
+    /** The parent written by the recorder, the information is written again
+        when the process is reparented. */
+    pid_t recorded_parent;
 } Proc_Data;
 
 enum {
@@ -86,9 +92,39 @@ enum {
     other functions. */
 void ps_init();
 
+/** Initializes the library without reading anything, the process data is
+    supplied through the `ps_feed_*` functions instead of `ps_update`. */
+void ps_init_feed();
+
 /** Reads process information. */
 void ps_update();
 
+/** Adds a process or updates its parent if it is already known.  If the known
+    process has a different start time the PID got reused and it's replaced.
+    The process is dropped by `ps_feed_end` unless it also gets a sample. */
+void ps_feed_info(
+    pid_t pid,
+    pid_t parent,
+    unsigned long start_time,
+    unsigned long cpu_time,
+    bool from_comm,
+    const char *command_line
+);
+
+/** Starts a fed update, any processes not given to `ps_feed_sample` before
+    `ps_feed_end` are removed. */
+void ps_feed_begin(unsigned long cpu_delta, unsigned long total_memory);
+
+/** Sets the CPU time used since the last update and the memory of a process
+    that was added by `ps_feed_info`, unknown processes are ignored. */
+void ps_feed_sample(pid_t pid, unsigned long cpu_delta, unsigned long memory);
+
+/** Finishes a fed update and sorts the processes. */
+void ps_feed_end();
+
+/** Removes all processes. */
+void ps_feed_clear();
+
 /** Sets thr sorting mode and sorts the processes accordingly, if the new mode
     is different from the last. */
 void ps_set_sort(int mode);
@@ -121,3 +157,19 @@ unsigned long ps_cpu_period();
 
 /** Returns the total amount of main memory. */
 unsigned long ps_total_memory();
+
+/** Calls `fn` for every process in the record, including those not in the
+    sorted list because their tree is folded.  The order is unspecified. */
+void ps_for_each(void (*fn)(Proc_Data *proc, void *arg), void *arg);
+
+/** Returns the number of processes in the record. */
+size_t ps_proc_count();
+
+/** Gets the total CPU time that passed during the last update. */
+unsigned long ps_cpu_delta();
+
+/** Returns the cumulative CPU time of the process. */
+unsigned long ps_proc_cpu_time(const Proc_Data *proc);
+
+/** Returns the CPU time the process used during the last update. */
+unsigned long ps_proc_cpu_delta(const Proc_Data *proc);
@@ -40,9 +40,7 @@ readstat_update(int dir_fd, Proc_Stat *stat_out) {
 
 unsigned long
 get_total_cpu() {
-    int dir_fd = open("/proc", O_RDONLY | O_DIRECTORY);
-    File_Content f = read_entire_file(dir_fd, "stat");
-    close(dir_fd);
+    File_Content f = read_entire_file(procfs_fd, "stat");
     if (f.size < 0) {
         return 0;
     }
@@ -55,9 +53,7 @@ get_total_cpu() {
 
 unsigned long
 get_total_memory() {
-    int dir_fd = open("/proc", O_RDONLY | O_DIRECTORY);
-    File_Content f = read_file(dir_fd, "meminfo", 40);
-    close(dir_fd);
+    File_Content f = read_file(procfs_fd, "meminfo", 40);
     if (f.size < 0) {
         return 0;
     }
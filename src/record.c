@@ -0,0 +1,280 @@
+#include "record.h"
+#include "profile.h"
+#include <sys/stat.h>
+
+extern struct timespec interval;
+
+static int record_fd = -1;
+static Record_Encoder record_encoder;
+static unsigned long record_dropped;
+/** Frames that did not fit into the ring at all and were written directly. */
+static unsigned long record_oversized;
+static int record_error;
+
+static uint8_t *record_ring;
+/** Total number of bytes ever queued and written, the ring positions are
+    these modulo the ring size. */
+static uint64_t record_head;
+static uint64_t record_tail;
+static bool record_stopping;
+static pthread_mutex_t record_mutex;
+static pthread_cond_t record_cond;
+/** Signaled by the writer whenever it frees part of the ring. */
+static pthread_cond_t record_space_cond;
+static pthread_t record_thread;
+
+static bool
+RecordWriteAll(const uint8_t *data, size_t size) {
+    while (size) {
+        const ssize_t n = write(record_fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            record_error = errno;
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static void *
+RecordWriter(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&record_mutex);
+    for (;;) {
+        while (record_head == record_tail && !record_stopping) {
+            pthread_cond_wait(&record_cond, &record_mutex);
+        }
+        if (record_head == record_tail) {
+            break;
+        }
+        // Only write up to the end of the ring, the rest is written on the
+        // next iteration.
+        const size_t offset = record_tail % RECORD_RING_SIZE;
+        const uint64_t contiguous = RECORD_RING_SIZE - offset;
+        const size_t size = Min(record_head - record_tail, contiguous);
+        pthread_mutex_unlock(&record_mutex);
+        // After a write error the data is discarded so the update thread never
+        // blocks, RecordStop reports the error.
+        if (!record_error) {
+            RecordWriteAll(record_ring + offset, size);
+        }
+        pthread_mutex_lock(&record_mutex);
+        record_tail += size;
+        pthread_cond_signal(&record_space_cond);
+    }
+    pthread_mutex_unlock(&record_mutex);
+    return NULL;
+}
+
+static void
+RecordCopyIn(const uint8_t *data, size_t size) {
+    while (size) {
+        const size_t offset = record_head % RECORD_RING_SIZE;
+        const size_t n = Min(size, (size_t)RECORD_RING_SIZE - offset);
+        memcpy(record_ring + offset, data, n);
+        record_head += n;
+        data += n;
+        size -= n;
+    }
+}
+
+/** Queues the size prefix and the frame, both or neither are queued.  Session
+    frames are never dropped, they wait for room.  A frame larger than the
+    whole ring is written directly once the writer caught up. */
+static bool
+RecordPush(const Record_Encoder *encoder) {
+    const size_t size = encoder->prefix_size + encoder->frame.size;
+    const bool session = encoder->frame.data[0] & RECORD_FRAME_SESSION;
+    pthread_mutex_lock(&record_mutex);
+    if (size > RECORD_RING_SIZE) {
+        // With the ring empty the writer waits for more and the mutex is held,
+        // so the frames stay in order.
+        while (record_head != record_tail) {
+            pthread_cond_wait(&record_space_cond, &record_mutex);
+        }
+        if (!record_error
+            && RecordWriteAll(encoder->prefix, encoder->prefix_size)) {
+            RecordWriteAll(encoder->frame.data, encoder->frame.size);
+        }
+        ++record_oversized;
+        pthread_mutex_unlock(&record_mutex);
+        return true;
+    }
+    while (session && record_head - record_tail + size > RECORD_RING_SIZE) {
+        pthread_cond_wait(&record_space_cond, &record_mutex);
+    }
+    const bool fits = record_head - record_tail + size <= RECORD_RING_SIZE;
+    if (fits) {
+        RecordCopyIn(encoder->prefix, encoder->prefix_size);
+        RecordCopyIn(encoder->frame.data, encoder->frame.size);
+        pthread_cond_signal(&record_cond);
+    }
+    pthread_mutex_unlock(&record_mutex);
+    return fits;
+}
+
+/** Checks the magic of a non-empty file, or writes it to an empty one. */
+static bool
+RecordPrepareFile(const char *pathname) {
+    struct stat st;
+    char magic[RECORD_MAGIC_SIZE];
+    if (fstat(record_fd, &st) != 0) {
+        return false;
+    }
+    if (st.st_size == 0) {
+        const uint8_t *magic_data = (const uint8_t *)RECORD_MAGIC;
+        return RecordWriteAll(magic_data, RECORD_MAGIC_SIZE);
+    }
+    if (pread(record_fd, magic, RECORD_MAGIC_SIZE, 0) != RECORD_MAGIC_SIZE
+        || memcmp(magic, RECORD_MAGIC, RECORD_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "sm: %s: not a recording\n", pathname);
+        errno = 0;
+        return false;
+    }
+    return true;
+}
+
+void
+RecordEncoderConstruct(Record_Encoder *self) {
+    FrameConstruct(&self->frame, 4096);
+    self->prefix_size = 0;
+    self->frame_count = 0;
+    self->last_time = 0;
+    self->resync = false;
+}
+
+void
+RecordEncoderDestroy(Record_Encoder *self) {
+    FrameDestroy(&self->frame);
+}
+
+void
+RecordEncode(Record_Encoder *self, Widget *const *widgets) {
+    Frame *frame = &self->frame;
+    const bool session = self->frame_count == 0 || self->resync;
+    const bool keyframe
+        = session || self->frame_count % RECORD_KEYFRAME_INTERVAL == 0;
+    const uint64_t now = ProfileNow();
+    FrameClear(frame);
+    FramePutU8(
+        frame,
+        (keyframe ? RECORD_FRAME_KEYFRAME : 0)
+            | (session ? RECORD_FRAME_SESSION : 0)
+    );
+    if (session) {
+        FramePutVarint(frame, now);
+        FramePutVarint(frame, time(NULL));
+        FramePutVarint(
+            frame, interval.tv_sec * 1000000000UL + interval.tv_nsec
+        );
+    } else {
+        FramePutVarint(frame, now - self->last_time);
+    }
+    self->last_time = now;
+    self->resync = false;
+    for (Widget *const *it = widgets; *it; ++it) {
+        (*it)->Record(frame, keyframe);
+    }
+    ++self->frame_count;
+
+    Frame prefix = {self->prefix, 0, sizeof(self->prefix)};
+    FramePutVarint(&prefix, frame->size);
+    self->prefix_size = prefix.size;
+}
+
+size_t
+RecordBegin(Frame *frame, int type) {
+    FramePutU8(frame, type);
+    return frame->size;
+}
+
+void
+RecordEnd(Frame *frame, size_t mark) {
+    FrameInsertVarint(frame, mark, frame->size - mark);
+}
+
+bool
+RecordStart(const char *pathname) {
+    const int flags = O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC;
+    record_fd = open(pathname, flags, 0644);
+    if (record_fd < 0 || !RecordPrepareFile(pathname)) {
+        if (errno) {
+            fprintf(stderr, "sm: %s: %s\n", pathname, strerror(errno));
+        }
+        if (record_fd >= 0) {
+            close(record_fd);
+            record_fd = -1;
+        }
+        return false;
+    }
+    RecordEncoderConstruct(&record_encoder);
+    record_ring = malloc(RECORD_RING_SIZE);
+    record_dropped = 0;
+    record_oversized = 0;
+    record_error = 0;
+    record_head = record_tail = 0;
+    record_stopping = false;
+    pthread_mutex_init(&record_mutex, NULL);
+    pthread_cond_init(&record_cond, NULL);
+    pthread_cond_init(&record_space_cond, NULL);
+    pthread_create(&record_thread, NULL, RecordWriter, NULL);
+    return true;
+}
+
+void
+RecordStop() {
+    if (record_fd < 0) {
+        return;
+    }
+    pthread_mutex_lock(&record_mutex);
+    record_stopping = true;
+    pthread_cond_signal(&record_cond);
+    pthread_mutex_unlock(&record_mutex);
+    pthread_join(record_thread, NULL);
+    pthread_cond_destroy(&record_cond);
+    pthread_cond_destroy(&record_space_cond);
+    pthread_mutex_destroy(&record_mutex);
+    close(record_fd);
+    record_fd = -1;
+    free(record_ring);
+    RecordEncoderDestroy(&record_encoder);
+    if (record_error) {
+        fprintf(stderr, "sm: recording failed: %s\n", strerror(record_error));
+    }
+    if (record_dropped) {
+        fprintf(
+            stderr,
+            "sm: recording: %lu frames dropped, the disk could not keep up\n",
+            record_dropped
+        );
+    }
+    if (record_oversized) {
+        fprintf(
+            stderr,
+            "sm: recording: %lu frames were larger than the %d KiB buffer and "
+            "were written without it, slowing down updates\n",
+            record_oversized,
+            RECORD_RING_SIZE >> 10
+        );
+    }
+}
+
+bool
+RecordActive() {
+    return record_fd >= 0;
+}
+
+void
+RecordFrame(Widget *const *widgets) {
+    RecordEncode(&record_encoder, widgets);
+    // If the frame could not be queued the next one starts a new session so
+    // the file stays decodable.
+    if (!RecordPush(&record_encoder)) {
+        record_encoder.resync = true;
+        ++record_dropped;
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "frame.h"
+#include "stdafx.h"
+#include "widget.h"
+
+/** Written once at the start of a recording file. */
+#define RECORD_MAGIC "SMREC\0\0\1"
+#define RECORD_MAGIC_SIZE 8
+
+/** Every n-th frame is a keyframe. */
+#define RECORD_KEYFRAME_INTERVAL 60
+
+/** Size of the buffer between the update thread and the writer thread, frames
+    are dropped if the writer falls this far behind.  Session frames wait for
+    room instead, and frames larger than this are written directly. */
+#define RECORD_RING_SIZE (1 << 20)
+
+/* The file is a sequence of frames, each frame is a varint payload size
+   followed by the payload:
+
+     u8      flags (RECORD_FRAME_*)
+     varint  CLOCK_MONOTONIC time in nanoseconds, relative to the previous
+             frame unless this is a session frame
+     [session frames only]
+     varint  wall clock time in seconds
+     varint  update interval in nanoseconds
+     records...
+
+   Each record is its type (RECORD_*) and the varint size of its payload,
+   followed by the payload whose layout is determined by the widget writing it.
+   Readers skip records they don't know.  New sessions are appended to existing
+   files. */
+
+enum {
+    /** All information needed to start decoding at this frame is included. */
+    RECORD_FRAME_KEYFRAME = 1,
+    /** First frame written by a process, the timestamp is absolute. */
+    RECORD_FRAME_SESSION = 2,
+};
+
+enum {
+    /** Never written, replay passes it to widgets to drop all state that is
+        restored by keyframes before seeking. */
+    RECORD_REPLAY_RESET = 0,
+    RECORD_CPU,
+    RECORD_MEMORY,
+    RECORD_MEMORY_INFO,
+    RECORD_NETWORK,
+    RECORD_NETWORK_INFO,
+    RECORD_DISK,
+    RECORD_TEMP,
+    RECORD_TEMP_INFO,
+    RECORD_PROC,
+    RECORD_PROC_INFO,
+    RECORD_CPU_MODES,
+};
+
+/** Encodes frames for one reader, either a file or a socket. */
+typedef struct {
+    /** The last encoded frame, without its size. */
+    Frame frame;
+    /** The size of `frame` as varint. */
+    uint8_t prefix[10];
+    size_t prefix_size;
+    unsigned long frame_count;
+    uint64_t last_time;
+    /** Makes the next frame a session keyframe, so a reader that missed the
+        previous frames can start decoding there. */
+    bool resync;
+} Record_Encoder;
+
+void RecordEncoderConstruct(Record_Encoder *self);
+void RecordEncoderDestroy(Record_Encoder *self);
+
+/** Encodes the latest samples of the given widgets into `frame` and its
+    size into `prefix`.  The list is terminated by NULL. */
+void RecordEncode(Record_Encoder *self, Widget *const *widgets);
+
+/** Starts a record of the given type, the returned mark is passed to
+    `RecordEnd` once the payload is written. */
+size_t RecordBegin(Frame *frame, int type);
+
+/** Finishes a record by filling in the size of its payload. */
+void RecordEnd(Frame *frame, size_t mark);
+
+/** Opens the file for appending and starts the writer thread.  Prints a
+    message and returns false if the file can't be used. */
+bool RecordStart(const char *pathname);
+
+/** Writes any remaining frames and closes the file. */
+void RecordStop();
+
+/** Whether samples are being recorded. */
+bool RecordActive();
+
+/** Encodes the latest samples of the given widgets into a frame and queues it
+    for writing.  The list is terminated by NULL. */
+void RecordFrame(Widget *const *widgets);
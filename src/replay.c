@@ -0,0 +1,535 @@
+#include "replay.h"
+#include "graph.h"
+#include "profile.h"
+#include "record.h"
+#include "sm.h"
+#include "socket.h"
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+extern struct timespec interval;
+
+typedef struct {
+    /** The records of the frame. */
+    const uint8_t *data;
+    size_t size;
+    /** Nanoseconds since the first frame, gaps between sessions count as a
+        single update interval. */
+    uint64_t time;
+    /** Wall clock time the frame was recorded at in nanoseconds since the
+        epoch, sessions only record whole seconds. */
+    uint64_t wall_time;
+    bool keyframe;
+} Replay_Frame;
+
+static uint8_t *replay_map;
+static size_t replay_map_size;
+static VECTOR(Replay_Frame) replay_frames;
+/** End time of the indexed frames. */
+static uint64_t replay_time;
+/** Wall clock time of the last indexed frame. */
+static uint64_t replay_wall_time;
+/** Interval of the current session, 0 before the first one. */
+static uint64_t replay_session_interval;
+
+/** Connection to a `--serve` process, -1 when replaying a file. */
+static int replay_fd = -1;
+/** Bytes received from the connection, the frames indexed from it point in
+    here until they are fed. */
+static uint8_t *replay_buffer;
+static size_t replay_buffer_size;
+static size_t replay_buffer_capacity;
+/** How many bytes at the start of the buffer were indexed. */
+static size_t replay_buffer_indexed;
+static bool replay_disconnected;
+
+static pthread_mutex_t replay_mutex;
+/** Index of the next frame to feed. */
+static size_t replay_position;
+/** 0 means as fast as possible. */
+static double replay_speed;
+static bool replay_seek_pending;
+static double replay_seek_seconds;
+/** When the next frame is due, in `ProfileNow` time. */
+static uint64_t replay_deadline;
+
+/** Parses the frame headers and returns the size of the complete frames.
+    Whatever follows them is a frame that is still being written, or was cut
+    off when the recorder got killed. */
+static size_t
+ReplayIndex(const uint8_t *data, size_t size) {
+    Frame_Reader stream = FrameReader(data, size);
+    size_t complete = 0;
+    while (!FrameReaderDone(&stream)) {
+        const size_t frame_size = FrameGetVarint(&stream);
+        const uint8_t *payload = FrameGetBytes(&stream, frame_size);
+        if (payload == NULL) {
+            break;
+        }
+        Frame_Reader frame = FrameReader(payload, frame_size);
+        const uint8_t flags = FrameGetU8(&frame);
+        const uint64_t timestamp = FrameGetVarint(&frame);
+        if (flags & RECORD_FRAME_SESSION) {
+            replay_wall_time = FrameGetVarint(&frame) * 1000000000UL;
+            const uint64_t recorded_interval = FrameGetVarint(&frame);
+            if (replay_session_interval == 0) {
+                interval.tv_sec = recorded_interval / 1000000000UL;
+                interval.tv_nsec = recorded_interval % 1000000000UL;
+            } else {
+                replay_time += replay_session_interval;
+            }
+            replay_session_interval = recorded_interval;
+        } else {
+            replay_time += timestamp;
+            replay_wall_time += timestamp;
+        }
+        if (frame.error) {
+            break;
+        }
+        vector_emplace_back(
+            replay_frames,
+            .data = frame.p,
+            .size = frame.end - frame.p,
+            .time = replay_time,
+            .wall_time = replay_wall_time,
+            .keyframe = flags & RECORD_FRAME_KEYFRAME
+        );
+        complete = stream.p - data;
+    }
+    return complete;
+}
+
+/** Maps the file, returns NULL and sets `errno` on failure. */
+static uint8_t *
+ReplayMap(const char *pathname, size_t *size_return) {
+    struct stat st;
+    uint8_t *map = NULL;
+    const int fd = open(pathname, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == 0) {
+        *size_return = st.st_size;
+        // Mapping an empty file fails, it's not a recording either way.
+        if (st.st_size < RECORD_MAGIC_SIZE) {
+            errno = 0;
+        } else {
+            map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) {
+                map = NULL;
+            }
+        }
+    }
+    close(fd);
+    return map;
+}
+
+bool
+ReplayOpen(const char *pathname, double speed) {
+    replay_map = ReplayMap(pathname, &replay_map_size);
+    if (replay_map == NULL) {
+        if (errno) {
+            fprintf(stderr, "sm: %s: %s\n", pathname, strerror(errno));
+        } else {
+            fprintf(stderr, "sm: %s: not a recording\n", pathname);
+        }
+        return false;
+    }
+    if (memcmp(replay_map, RECORD_MAGIC, RECORD_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "sm: %s: not a recording\n", pathname);
+        munmap(replay_map, replay_map_size);
+        replay_map = NULL;
+        return false;
+    }
+    replay_frames = vector_create(Replay_Frame, 1024);
+    replay_time = 0;
+    replay_session_interval = 0;
+    ReplayIndex(
+        replay_map + RECORD_MAGIC_SIZE, replay_map_size - RECORD_MAGIC_SIZE
+    );
+    if (vector_empty(replay_frames)) {
+        fprintf(stderr, "sm: %s: the recording has no frames\n", pathname);
+        vector_free(replay_frames);
+        munmap(replay_map, replay_map_size);
+        replay_map = NULL;
+        return false;
+    }
+    replay_position = 0;
+    replay_speed = speed;
+    replay_seek_pending = false;
+    replay_deadline = 0;
+    pthread_mutex_init(&replay_mutex, NULL);
+    return true;
+}
+
+/** Waits up to `timeout` milliseconds for data from the connection and
+    indexes the frames it completes.  Returns false once the connection is
+    closed. */
+static bool
+ReplayReceive(int timeout) {
+    struct pollfd pfd = {.fd = replay_fd, .events = POLLIN};
+    const int ready = poll(&pfd, 1, timeout);
+    if (ready < 0 && errno != EINTR) {
+        return false;
+    }
+    if (ready <= 0) {
+        return true;
+    }
+    // Keyframes with many processes can be larger than the buffer.
+    if (replay_buffer_capacity - replay_buffer_size < REPLAY_RECEIVE_SIZE) {
+        replay_buffer_capacity *= 2;
+        replay_buffer = realloc(replay_buffer, replay_buffer_capacity);
+    }
+    const ssize_t n = recv(
+        replay_fd,
+        replay_buffer + replay_buffer_size,
+        replay_buffer_capacity - replay_buffer_size,
+        MSG_DONTWAIT
+    );
+    if (n < 0) {
+        return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if (n == 0) {
+        return false;
+    }
+    replay_buffer_size += n;
+    replay_buffer_indexed += ReplayIndex(
+        replay_buffer + replay_buffer_indexed,
+        replay_buffer_size - replay_buffer_indexed
+    );
+    return true;
+}
+
+bool
+ReplayAttach(const char *address) {
+    replay_fd = SocketConnect(address);
+    if (replay_fd < 0) {
+        return false;
+    }
+    replay_buffer_capacity = 4 * REPLAY_RECEIVE_SIZE;
+    replay_buffer = malloc(replay_buffer_capacity);
+    replay_buffer_size = replay_buffer_indexed = 0;
+    replay_frames = vector_create(Replay_Frame, 16);
+    replay_time = 0;
+    replay_session_interval = 0;
+    replay_disconnected = false;
+    pthread_mutex_init(&replay_mutex, NULL);
+    // Widgets size themselves from the first frame in their `Init`.
+    const uint64_t deadline
+        = ProfileNow() + REPLAY_ATTACH_TIMEOUT * (uint64_t)1000000;
+    while (vector_empty(replay_frames)) {
+        const char *error = NULL;
+        if (!ReplayReceive(REPLAY_ATTACH_TIMEOUT)) {
+            error = "the connection was closed";
+        } else if (ProfileNow() >= deadline) {
+            error = "no data received";
+        }
+        if (error) {
+            fprintf(stderr, "sm: %s: %s\n", address, error);
+            ReplayClose();
+            return false;
+        }
+    }
+    replay_position = 0;
+    replay_speed = 1.0;
+    replay_seek_pending = false;
+    return true;
+}
+
+void
+ReplayClose() {
+    if (replay_fd >= 0) {
+        close(replay_fd);
+        replay_fd = -1;
+        free(replay_buffer);
+    } else if (replay_map != NULL) {
+        munmap(replay_map, replay_map_size);
+        replay_map = NULL;
+    } else {
+        return;
+    }
+    pthread_mutex_destroy(&replay_mutex);
+    vector_free(replay_frames);
+}
+
+bool
+ReplayActive() {
+    return replay_map != NULL || replay_fd >= 0;
+}
+
+/** Calls `fn` for every record in the frame until it returns true. */
+static bool
+ReplayForEachRecord(
+    const Replay_Frame *frame,
+    bool (*fn)(int type, Frame_Reader *record, void *arg),
+    void *arg
+) {
+    Frame_Reader reader = FrameReader(frame->data, frame->size);
+    while (!FrameReaderDone(&reader)) {
+        const int type = FrameGetU8(&reader);
+        const size_t size = FrameGetVarint(&reader);
+        const void *data = FrameGetBytes(&reader, size);
+        if (data == NULL) {
+            break;
+        }
+        Frame_Reader record = FrameReader(data, size);
+        if (fn(type, &record, arg)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    int type;
+    Frame_Reader *result;
+} Replay_Peek;
+
+static bool
+ReplayPeekRecord(int type, Frame_Reader *record, void *arg) {
+    Replay_Peek *peek = arg;
+    if (type == peek->type) {
+        *peek->result = *record;
+        return true;
+    }
+    return false;
+}
+
+bool
+ReplayPeek(int type, Frame_Reader *reader) {
+    Replay_Peek peek = {type, reader};
+    vector_for_each (replay_frames, frame) {
+        if (ReplayForEachRecord(frame, ReplayPeekRecord, &peek)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool
+ReplayFeedRecord(int type, Frame_Reader *record, void *arg) {
+    for (Widget *const *it = arg; *it; ++it) {
+        Frame_Reader copy = *record;
+        (*it)->Replay(&copy, type);
+    }
+    return false;
+}
+
+static void
+ReplayFeed(Widget *const *widgets, const Replay_Frame *frame) {
+    // The samples are from when the frame was recorded, not from now.
+    GraphSetSampleTime(frame->wall_time / 100000000);
+    ReplayForEachRecord(frame, ReplayFeedRecord, (void *)widgets);
+}
+
+/** Returns the index of the first frame at or after the given time, or the
+    last frame. */
+static size_t
+ReplayFindFrame(uint64_t time) {
+    size_t lo = 0, hi = vector_size(replay_frames) - 1;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (replay_frames[mid].time < time) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/** Rebuilds the widget state at the target frame from the closest keyframe
+    that leaves enough history before it. */
+static size_t
+ReplaySeekTo(Widget *const *widgets, size_t target) {
+    size_t start = target > REPLAY_SEEK_HISTORY ? target - REPLAY_SEEK_HISTORY
+                                                : 0;
+    while (start && !replay_frames[start].keyframe) {
+        --start;
+    }
+    Frame_Reader none = FrameReader(NULL, 0);
+    for (Widget *const *it = widgets; *it; ++it) {
+        (*it)->Replay(&none, RECORD_REPLAY_RESET);
+    }
+    for (size_t i = start; i <= target; ++i) {
+        ReplayFeed(widgets, &replay_frames[i]);
+    }
+    return target + 1;
+}
+
+/** Feeds every indexed frame and drops them from the buffer. */
+static void
+ReplayFeedReceived(Widget *const *widgets) {
+    pthread_mutex_lock(&draw_mutex);
+    vector_for_each (replay_frames, frame) {
+        ReplayFeed(widgets, frame);
+    }
+    pthread_mutex_unlock(&draw_mutex);
+    vector_clear(replay_frames);
+    replay_buffer_size -= replay_buffer_indexed;
+    memmove(
+        replay_buffer, replay_buffer + replay_buffer_indexed, replay_buffer_size
+    );
+    replay_buffer_indexed = 0;
+}
+
+/** Feeds frames as they arrive from the connection, there is nothing to wait
+    for since the other end already sends them in time. */
+static uint64_t
+ReplayStepAttached(Widget *const *widgets) {
+    const uint64_t idle = interval.tv_sec * 1000000000UL + interval.tv_nsec;
+    // The frames from `ReplayAttach` come first.
+    ReplayFeedReceived(widgets);
+    if (replay_disconnected) {
+        return idle;
+    }
+    const bool connected = ReplayReceive(idle / 1000000 + 1);
+    ReplayFeedReceived(widgets);
+    if (!connected) {
+        pthread_mutex_lock(&replay_mutex);
+        replay_disconnected = true;
+        pthread_mutex_unlock(&replay_mutex);
+    }
+    return 0;
+}
+
+uint64_t
+ReplayStep(Widget *const *widgets) {
+    if (replay_fd >= 0) {
+        return ReplayStepAttached(widgets);
+    }
+    const uint64_t idle = interval.tv_sec * 1000000000UL + interval.tv_nsec;
+    const size_t count = vector_size(replay_frames);
+    const uint64_t now = ProfileNow();
+    pthread_mutex_lock(&replay_mutex);
+    size_t position = replay_position;
+    const bool seek = replay_seek_pending;
+    const double seconds = replay_seek_seconds;
+    const double speed = replay_speed;
+    replay_seek_pending = false;
+    pthread_mutex_unlock(&replay_mutex);
+
+    bool fed = true;
+    // The zoom and pan keys read the graphs the frames are fed to.
+    pthread_mutex_lock(&draw_mutex);
+    if (seek) {
+        const int64_t time = replay_frames[position ? position - 1 : 0].time;
+        const int64_t offset = seconds * 1e9;
+        const int64_t target = Max(time + offset, (int64_t)0);
+        position = ReplaySeekTo(widgets, ReplayFindFrame(target));
+    } else if (position < count && (speed == 0.0 || now >= replay_deadline)) {
+        ReplayFeed(widgets, &replay_frames[position++]);
+    } else {
+        fed = false;
+    }
+    pthread_mutex_unlock(&draw_mutex);
+    if (fed && position < count && speed != 0.0) {
+        const uint64_t delta
+            = replay_frames[position].time - replay_frames[position - 1].time;
+        replay_deadline = now + delta / speed;
+    }
+
+    pthread_mutex_lock(&replay_mutex);
+    replay_position = position;
+    pthread_mutex_unlock(&replay_mutex);
+
+    if (position >= count) {
+        return idle;
+    }
+    if (speed == 0.0) {
+        return 0;
+    }
+    // Wake up at least once per interval so seeking and speed changes don't
+    // have to wait for slowly replayed frames.
+    return replay_deadline > now ? Min(replay_deadline - now, idle) : 0;
+}
+
+void
+ReplaySeek(double seconds) {
+    if (replay_fd >= 0) {
+        return;
+    }
+    pthread_mutex_lock(&replay_mutex);
+    if (replay_seek_pending) {
+        replay_seek_seconds += seconds;
+    } else {
+        replay_seek_seconds = seconds;
+        replay_seek_pending = true;
+    }
+    pthread_mutex_unlock(&replay_mutex);
+}
+
+void
+ReplayChangeSpeed(double factor) {
+    if (replay_fd >= 0) {
+        return;
+    }
+    pthread_mutex_lock(&replay_mutex);
+    // Unlimited speed sits above the maximum.
+    if (replay_speed == 0.0) {
+        if (factor < 1.0) {
+            replay_speed = REPLAY_MAX_SPEED;
+        }
+    } else {
+        replay_speed = Max(replay_speed * factor, REPLAY_MIN_SPEED);
+        if (replay_speed > REPLAY_MAX_SPEED) {
+            replay_speed = 0.0;
+        }
+    }
+    pthread_mutex_unlock(&replay_mutex);
+}
+
+static void
+ReplayFormatTime(char *buf, size_t size, uint64_t ns) {
+    const unsigned long seconds = ns / 1000000000UL;
+    if (seconds >= 3600) {
+        snprintf(
+            buf,
+            size,
+            "%lu:%02lu:%02lu",
+            seconds / 3600,
+            seconds / 60 % 60,
+            seconds % 60
+        );
+    } else {
+        snprintf(buf, size, "%02lu:%02lu", seconds / 60, seconds % 60);
+    }
+}
+
+void
+ReplayStatus(char *buf, size_t size) {
+    char position[16], length[16], speed[16];
+    if (replay_fd >= 0) {
+        pthread_mutex_lock(&replay_mutex);
+        const bool disconnected = replay_disconnected;
+        pthread_mutex_unlock(&replay_mutex);
+        snprintf(
+            buf, size, "%-12s", disconnected ? "Disconnected" : "Attached"
+        );
+        return;
+    }
+    pthread_mutex_lock(&replay_mutex);
+    const size_t index = replay_position ? replay_position - 1 : 0;
+    ReplayFormatTime(position, sizeof(position), replay_frames[index].time);
+    if (replay_speed == 0.0) {
+        strcpy(speed, "max");
+    } else {
+        snprintf(speed, sizeof(speed), "%gx", replay_speed);
+    }
+    pthread_mutex_unlock(&replay_mutex);
+    const uint64_t end = vector_end(replay_frames)[-1].time;
+    ReplayFormatTime(length, sizeof(length), end);
+    // Fixed widths so a shorter status doesn't leave parts of the previous one
+    // on the border.
+    snprintf(
+        buf,
+        size,
+        "Replay %*s/%s %7s",
+        (int)strlen(length),
+        position,
+        length,
+        speed
+    );
+}
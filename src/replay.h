@@ -0,0 +1,55 @@
+#pragma once
+#include "frame.h"
+#include "stdafx.h"
+#include "widget.h"
+
+/** How many frames before a seek target get replayed so the graphs are filled
+    like they would be when playing up to it. */
+#define REPLAY_SEEK_HISTORY 1024
+
+/** Seconds moved by a single seek. */
+#define REPLAY_SEEK_STEP 10.0
+
+#define REPLAY_MIN_SPEED (1.0 / 16.0)
+#define REPLAY_MAX_SPEED 256.0
+
+/** Milliseconds `ReplayAttach` waits for the first frame. */
+#define REPLAY_ATTACH_TIMEOUT 10000
+
+/** Bytes read from a `--serve` connection at once. */
+#define REPLAY_RECEIVE_SIZE 65536
+
+/** Maps a file created by `--record` and indexes its frames.  The update
+    interval is set to the one used when recording.  A speed of 0 replays
+    frames as fast as they can be drawn.  Prints a message and returns false
+    if the file can't be used. */
+bool ReplayOpen(const char *pathname, double speed);
+
+/** Connects to a process started with `--serve` and waits for its first
+    frame, after that frames are fed as they arrive and seeking is not
+    possible.  Prints a message and returns false on failure. */
+bool ReplayAttach(const char *address);
+
+void ReplayClose();
+
+/** Whether the widgets are driven by a recording or a `--serve` process. */
+bool ReplayActive();
+
+/** Finds the first record of the given type, so widgets can size themselves
+    to the recorded data in their `Init`. */
+bool ReplayPeek(int type, Frame_Reader *reader);
+
+/** Gives the next frame, or all frames leading up to a requested seek target,
+    to the `Replay` function of the widgets.  Returns the time to wait before
+    the next call in nanoseconds. */
+uint64_t ReplayStep(Widget *const *widgets);
+
+/** Requests moving the given number of seconds forward or backward, this is
+    done by the next `ReplayStep`. */
+void ReplaySeek(double seconds);
+
+/** Multiplies the replay speed by the given factor. */
+void ReplayChangeSpeed(double factor);
+
+/** Writes the position and speed for display. */
+void ReplayStatus(char *buf, size_t size);
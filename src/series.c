@@ -0,0 +1,252 @@
+#include "series.h"
+
+/** The most bits a single sample can take, a block is finished once less
+    than this is left. */
+#define SERIES_SAMPLE_BITS (4 + 32 + 2 + 5 + 6 + 64)
+
+#define SERIES_NO_WINDOW UINT8_MAX
+
+void
+SeriesConstruct(Series *self) {
+    memset(self, 0, sizeof(*self));
+}
+
+void
+SeriesDestroy(Series *self) {
+    for (unsigned i = 0; i < SERIES_MAX_BLOCKS; ++i) {
+        free(self->blocks[i]);
+    }
+}
+
+void
+SeriesClear(Series *self) {
+    self->first = 0;
+    self->block_count = 0;
+    self->count = 0;
+}
+
+static void
+SeriesPutBits(Series_Block *block, uint64_t value, unsigned n) {
+    while (n > 0) {
+        uint8_t *byte = &block->data[block->bits >> 3];
+        const unsigned room = 8 - (block->bits & 7);
+        const unsigned take = Min(n, room);
+        if (room == 8) {
+            *byte = 0;
+        }
+        *byte |= ((value >> (n - take)) & ((1u << take) - 1)) << (room - take);
+        block->bits += take;
+        n -= take;
+    }
+}
+
+static uint64_t
+SeriesGetBits(const Series_Block *block, uint32_t *bit, unsigned n) {
+    uint64_t value = 0;
+    while (n > 0) {
+        const uint8_t byte = block->data[*bit >> 3];
+        const unsigned room = 8 - (*bit & 7);
+        const unsigned take = Min(n, room);
+        value = (value << take) | ((byte >> (room - take)) & ((1u << take) - 1));
+        *bit += take;
+        n -= take;
+    }
+    return value;
+}
+
+/** Reads an `n` bit value in the range -(2^(n-1)-1) ~ 2^(n-1). */
+static int64_t
+SeriesGetSigned(const Series_Block *block, uint32_t *bit, unsigned n) {
+    const int64_t value = SeriesGetBits(block, bit, n);
+    return value > (INT64_C(1) << (n - 1)) ? value - (INT64_C(1) << n) : value;
+}
+
+/** Starts a new block, reusing the oldest one once all of them are taken. */
+static Series_Block *
+SeriesNewBlock(Series *self) {
+    unsigned index;
+    if (self->block_count < SERIES_MAX_BLOCKS) {
+        index = (self->first + self->block_count) % SERIES_MAX_BLOCKS;
+        if (self->blocks[index] == NULL) {
+            self->blocks[index] = malloc(sizeof(Series_Block));
+        }
+        ++self->block_count;
+    } else {
+        index = self->first;
+        self->first = (self->first + 1) % SERIES_MAX_BLOCKS;
+        self->count -= self->blocks[index]->count;
+    }
+    Series_Block *block = self->blocks[index];
+    block->count = 0;
+    block->bits = 0;
+    return block;
+}
+
+static inline uint64_t
+SeriesTruncate(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits & ~((UINT64_C(1) << (52 - SERIES_MANTISSA_BITS)) - 1);
+}
+
+void
+SeriesAppend(Series *self, uint64_t time, double value) {
+    const uint64_t bits = SeriesTruncate(value);
+    Series_Block *block = NULL;
+    if (self->block_count > 0) {
+        block = self->blocks
+            [(self->first + self->block_count - 1) % SERIES_MAX_BLOCKS];
+    }
+    if (block == NULL
+        || block->bits + SERIES_SAMPLE_BITS > SERIES_BLOCK_SIZE * 8) {
+        block = SeriesNewBlock(self);
+        block->time = time;
+        SeriesPutBits(block, bits, 64);
+        self->last_time = time;
+        self->last_delta = 0;
+        self->last_value = bits;
+        self->leading = SERIES_NO_WINDOW;
+        self->trailing = 0;
+        ++block->count;
+        ++self->count;
+        return;
+    }
+
+    const int64_t delta = time - self->last_time;
+    const int64_t dod = delta - self->last_delta;
+    if (dod == 0) {
+        SeriesPutBits(block, 0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        SeriesPutBits(block, 0x2, 2);
+        SeriesPutBits(block, dod, 7);
+    } else if (dod >= -255 && dod <= 256) {
+        SeriesPutBits(block, 0x6, 3);
+        SeriesPutBits(block, dod, 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        SeriesPutBits(block, 0xe, 4);
+        SeriesPutBits(block, dod, 12);
+    } else {
+        SeriesPutBits(block, 0xf, 4);
+        SeriesPutBits(block, Clamp(dod, -INT32_MAX, INT64_C(1) << 31), 32);
+    }
+    self->last_time = time;
+    self->last_delta = delta;
+
+    const uint64_t xor = bits ^ self->last_value;
+    if (xor == 0) {
+        SeriesPutBits(block, 0, 1);
+    } else {
+        const unsigned leading = Min(__builtin_clzll(xor), 31);
+        const unsigned trailing = __builtin_ctzll(xor);
+        if (self->leading != SERIES_NO_WINDOW && leading >= self->leading
+            && trailing >= self->trailing) {
+            // Fits into the window of the previous value.
+            SeriesPutBits(block, 0x2, 2);
+            SeriesPutBits(
+                block,
+                xor >> self->trailing,
+                64 - self->leading - self->trailing
+            );
+        } else {
+            const unsigned length = 64 - leading - trailing;
+            SeriesPutBits(block, 0x3, 2);
+            SeriesPutBits(block, leading, 5);
+            SeriesPutBits(block, length - 1, 6);
+            SeriesPutBits(block, xor >> trailing, length);
+            self->leading = leading;
+            self->trailing = trailing;
+        }
+    }
+    self->last_value = bits;
+    ++block->count;
+    ++self->count;
+}
+
+size_t
+SeriesSize(const Series *self) {
+    size_t bits = 0;
+    for (unsigned i = 0; i < self->block_count; ++i) {
+        bits += self->blocks[(self->first + i) % SERIES_MAX_BLOCKS]->bits;
+    }
+    return (bits + 7) / 8 + self->block_count * sizeof(uint64_t);
+}
+
+bool
+SeriesSeek(const Series *self, Series_Reader *reader, size_t index) {
+    if (index >= self->count) {
+        return false;
+    }
+    *reader = (Series_Reader){.series = self};
+    // Blocks can only be decoded from the start, skip over the whole ones.
+    const Series_Block *block;
+    while (index
+           >= (block = self->blocks
+                   [(self->first + reader->block) % SERIES_MAX_BLOCKS])
+                  ->count) {
+        index -= block->count;
+        ++reader->block;
+    }
+    uint64_t time;
+    double value;
+    while (index-- > 0) {
+        SeriesNext(reader, &time, &value);
+    }
+    return true;
+}
+
+bool
+SeriesNext(Series_Reader *self, uint64_t *time_out, double *value_out) {
+    const Series *series = self->series;
+    if (self->block >= series->block_count) {
+        return false;
+    }
+    const Series_Block *block
+        = series->blocks[(series->first + self->block) % SERIES_MAX_BLOCKS];
+    if (self->position == block->count) {
+        if (++self->block == series->block_count) {
+            return false;
+        }
+        block = series->blocks
+            [(series->first + self->block) % SERIES_MAX_BLOCKS];
+        self->position = 0;
+        self->bit = 0;
+    }
+    if (self->position == 0) {
+        self->time = block->time;
+        self->delta = 0;
+        self->value = SeriesGetBits(block, &self->bit, 64);
+        self->leading = SERIES_NO_WINDOW;
+        self->trailing = 0;
+    } else {
+        int64_t dod;
+        if (SeriesGetBits(block, &self->bit, 1) == 0) {
+            dod = 0;
+        } else if (SeriesGetBits(block, &self->bit, 1) == 0) {
+            dod = SeriesGetSigned(block, &self->bit, 7);
+        } else if (SeriesGetBits(block, &self->bit, 1) == 0) {
+            dod = SeriesGetSigned(block, &self->bit, 9);
+        } else if (SeriesGetBits(block, &self->bit, 1) == 0) {
+            dod = SeriesGetSigned(block, &self->bit, 12);
+        } else {
+            dod = SeriesGetSigned(block, &self->bit, 32);
+        }
+        self->delta += dod;
+        self->time += self->delta;
+
+        if (SeriesGetBits(block, &self->bit, 1) == 1) {
+            if (SeriesGetBits(block, &self->bit, 1) == 1) {
+                self->leading = SeriesGetBits(block, &self->bit, 5);
+                const unsigned length
+                    = SeriesGetBits(block, &self->bit, 6) + 1;
+                self->trailing = 64 - self->leading - length;
+            }
+            const unsigned length = 64 - self->leading - self->trailing;
+            self->value ^= SeriesGetBits(block, &self->bit, length)
+                           << self->trailing;
+        }
+    }
+    ++self->position;
+    *time_out = self->time;
+    memcpy(value_out, &self->value, sizeof(*value_out));
+    return true;
+}
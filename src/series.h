@@ -0,0 +1,74 @@
+#pragma once
+#include "stdafx.h"
+
+/** Size of the encoded data of a single block. */
+#define SERIES_BLOCK_SIZE 1024
+/** Number of blocks kept, the oldest one is reused once all are full.  At the
+    2-3 bytes a noisy sample takes that is about 28 thousand samples, or 4
+    hours at the default interval; further back only the consolidated history
+    of the graphs is left. */
+#define SERIES_MAX_BLOCKS 64
+/** Mantissa bits kept of every value, the rest are zeroed so consecutive
+    values share more bits.  Far more than a graph can show. */
+#define SERIES_MANTISSA_BITS 12
+
+/** Timestamps are delta-of-delta encoded and values are XOR-ed with the
+    previous one (as described in Facebook's Gorilla paper), so a sample only
+    takes a bit or two when nothing changed.  Every block starts over and can
+    be decoded on its own. */
+typedef struct {
+    uint64_t time;
+    uint32_t count;
+    uint32_t bits;
+    uint8_t data[SERIES_BLOCK_SIZE];
+} Series_Block;
+
+/** An append only store of timestamped samples with bounded memory. */
+typedef struct {
+    Series_Block *blocks[SERIES_MAX_BLOCKS];
+    /** Index of the oldest block in `blocks`. */
+    unsigned first;
+    unsigned block_count;
+    /** Number of samples in all blocks. */
+    size_t count;
+    /** Encoder state, continued by the next sample of the last block. */
+    uint64_t last_time;
+    int64_t last_delta;
+    uint64_t last_value;
+    uint8_t leading;
+    uint8_t trailing;
+} Series;
+
+/** Decodes a series sequentially, starting at any sample.  Nothing may be
+    appended to the series while a reader is in use. */
+typedef struct {
+    const Series *series;
+    /** Block being decoded, relative to `first`. */
+    unsigned block;
+    uint32_t position;
+    uint32_t bit;
+    uint64_t time;
+    int64_t delta;
+    uint64_t value;
+    uint8_t leading;
+    uint8_t trailing;
+} Series_Reader;
+
+void SeriesConstruct(Series *self);
+void SeriesDestroy(Series *self);
+
+/** Removes all samples, keeping the blocks around for reuse. */
+void SeriesClear(Series *self);
+
+/** Appends a sample, `time` is expected to never decrease. */
+void SeriesAppend(Series *self, uint64_t time, double value);
+
+/** Returns the number of bytes used by the encoded samples. */
+size_t SeriesSize(const Series *self);
+
+/** Positions the reader so the next sample it returns is the one at `index`,
+    counting from the oldest one.  Returns false if there is no such sample. */
+bool SeriesSeek(const Series *self, Series_Reader *reader, size_t index);
+
+/** Decodes the next sample.  Returns false after the newest one. */
+bool SeriesNext(Series_Reader *self, uint64_t *time_out, double *value_out);
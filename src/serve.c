@@ -0,0 +1,207 @@
+#include "serve.h"
+#include "cpu.h"
+#include "disk.h"
+#include "memory.h"
+#include "network.h"
+#include "proc.h"
+#include "record.h"
+#include "shm.h"
+#include "socket.h"
+#include "temp.h"
+#include <sys/socket.h>
+
+extern struct timespec interval;
+
+typedef struct {
+    int fd;
+    /** Whatever the socket did not take yet, sent before any new frame. */
+    Frame backlog;
+} Serve_Client;
+
+/** Only widgets whose collectors work without a window. */
+static Widget *const serve_widgets[] = {
+    &cpu_widget,
+    &mem_widget,
+    &net_widget,
+    &disk_widget,
+    &temp_widget,
+    &proc_widget,
+    NULL,
+};
+
+static volatile sig_atomic_t serve_stopping;
+static VECTOR(Serve_Client) serve_clients;
+static Record_Encoder serve_encoder;
+
+static void
+ServeStop(int signal) {
+    (void)signal;
+    serve_stopping = true;
+}
+
+/** Accepts every pending connection, new clients make the next frame a
+    keyframe. */
+static void
+ServeAccept(int listen_fd) {
+    for (;;) {
+        const int fd
+            = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+        Serve_Client client = {.fd = fd};
+        FrameConstruct(&client.backlog, 4096);
+        vector_push(serve_clients, client);
+        serve_encoder.resync = true;
+    }
+}
+
+/** Sends as much as the socket takes without blocking, returns the number of
+    bytes sent or -1 if the client went away. */
+static ssize_t
+ServeSend(int fd, const uint8_t *data, size_t size) {
+    size_t sent = 0;
+    while (sent < size) {
+        const ssize_t n
+            = send(fd, data + sent, size - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        sent += n;
+    }
+    return sent;
+}
+
+/** Flushes the backlog and then the data, queueing what doesn't fit.
+    Returns false if the client has to be disconnected. */
+static bool
+ServeWrite(Serve_Client *client, const uint8_t *data, size_t size) {
+    if (client->backlog.size) {
+        const ssize_t n
+            = ServeSend(client->fd, client->backlog.data, client->backlog.size);
+        if (n < 0) {
+            return false;
+        }
+        const size_t left = client->backlog.size - n;
+        memmove(client->backlog.data, client->backlog.data + n, left);
+        client->backlog.size = left;
+    }
+    if (client->backlog.size == 0) {
+        const ssize_t n = ServeSend(client->fd, data, size);
+        if (n < 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    FramePutBytes(&client->backlog, data, size);
+    return client->backlog.size <= SERVE_BACKLOG_LIMIT;
+}
+
+static void
+ServeDisconnect(Serve_Client *client) {
+    close(client->fd);
+    FrameDestroy(&client->backlog);
+}
+
+/** Sends the latest frame to every client.  The frame is encoded once no
+    matter how many clients there are. */
+static void
+ServeBroadcast() {
+    const Record_Encoder *encoder = &serve_encoder;
+    for (size_t i = 0; i < vector_size(serve_clients);) {
+        Serve_Client *client = &serve_clients[i];
+        const bool ok
+            = ServeWrite(client, encoder->prefix, encoder->prefix_size)
+              && ServeWrite(client, encoder->frame.data, encoder->frame.size);
+        if (ok) {
+            ++i;
+        } else {
+            ServeDisconnect(client);
+            vector_remove(serve_clients, i);
+        }
+    }
+}
+
+int
+Serve(const char *address, const char *shm_name) {
+    int listen_fd = -1;
+    if (address) {
+        listen_fd = SocketListen(address);
+        if (listen_fd < 0) {
+            return 1;
+        }
+        fcntl(listen_fd, F_SETFL, O_NONBLOCK);
+    }
+    serve_stopping = false;
+    signal(SIGINT, ServeStop);
+    signal(SIGTERM, ServeStop);
+    signal(SIGPIPE, SIG_IGN);
+    // The process command lines are built with colors for the process list.
+    theme = CreateNamedTheme("default");
+
+    CpuCollectorInit();
+    MemoryCollectorInit();
+    NetworkCollectorInit();
+    DiskCollectorInit();
+    TempCollectorInit();
+    ProcCollectorInit();
+    RecordEncoderConstruct(&serve_encoder);
+    serve_clients = vector_create(Serve_Client, 8);
+    int status = 0;
+    if (shm_name && !ShmStart(shm_name)) {
+        serve_stopping = true;
+        status = 1;
+    }
+
+    while (!serve_stopping) {
+        nanosleep(&interval, NULL);
+        if (serve_stopping) {
+            break;
+        }
+        for (Widget *const *it = serve_widgets; *it; ++it) {
+            (*it)->Update();
+        }
+        if (shm_name) {
+            ShmPublish();
+        }
+        if (listen_fd >= 0) {
+            ServeAccept(listen_fd);
+        }
+        // Without clients the samples still have to be collected so rates and
+        // graphs are right once someone attaches, only encoding is skipped.
+        if (vector_empty(serve_clients)) {
+            continue;
+        }
+        RecordEncode(&serve_encoder, serve_widgets);
+        ServeBroadcast();
+    }
+
+    ShmStop();
+    vector_for_each (serve_clients, client) {
+        ServeDisconnect(client);
+    }
+    vector_free(serve_clients);
+    RecordEncoderDestroy(&serve_encoder);
+    ProcCollectorQuit();
+    TempCollectorQuit();
+    DiskCollectorQuit();
+    NetworkCollectorQuit();
+    MemoryCollectorQuit();
+    CpuCollectorQuit();
+    free(theme);
+    theme = NULL;
+    if (listen_fd >= 0) {
+        SocketClose(listen_fd, address);
+    }
+    return status;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "stdafx.h"
+
+/** Bytes a client may fall behind before it gets disconnected. */
+#define SERVE_BACKLOG_LIMIT (1 << 20)
+
+/** Runs the collectors of all widgets without curses and streams their
+    samples to every client attached with `--attach`, in the `--record`
+    format.  A client gets a keyframe when it connects and only the samples
+    after that.  `address` is understood like by `SocketListen`.  If
+    `shm_name` is given every update is published to that shared memory
+    object as well, either may be NULL.  Runs until SIGINT or SIGTERM,
+    returns the exit status. */
+int Serve(const char *address, const char *shm_name);
@@ -0,0 +1,150 @@
+#include "shm.h"
+#include "cpu.h"
+#include "memory.h"
+#include "network.h"
+#include "ps/ps.h"
+#include "util.h"
+#include <sys/mman.h>
+
+extern struct timespec interval;
+
+static char *shm_name;
+static uint8_t *shm_map;
+static size_t shm_size;
+static Shm_Header *shm_header;
+static double *shm_rings;
+static Shm_Proc *shm_procs;
+static char *shm_strings;
+
+typedef struct {
+    uint32_t count;
+    uint32_t string_size;
+} Shm_Proc_State;
+
+bool
+ShmStart(const char *name) {
+    // shm_open wants a single leading slash.
+    shm_name = name[0] == '/' ? strdup(name) : Format("/%s", name);
+    const uint32_t ring_count = SHM_RING_CPU + CpuCount();
+    const size_t ring_offset = sizeof(Shm_Header);
+    const size_t proc_offset
+        = ring_offset + sizeof(double) * ring_count * SHM_RING_SIZE;
+    const size_t string_offset
+        = proc_offset + sizeof(Shm_Proc) * SHM_MAX_PROCS;
+    shm_size = string_offset + SHM_STRING_POOL_SIZE;
+
+    const int fd = shm_open(shm_name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || ftruncate(fd, shm_size) != 0
+        || (shm_map = mmap(
+                NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0
+            ))
+               == MAP_FAILED) {
+        fprintf(stderr, "sm: %s: %s\n", shm_name, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(shm_name);
+        }
+        free(shm_name);
+        shm_map = NULL;
+        return false;
+    }
+    close(fd);
+
+    shm_header = (Shm_Header *)shm_map;
+    shm_rings = (double *)(shm_map + ring_offset);
+    shm_procs = (Shm_Proc *)(shm_map + proc_offset);
+    shm_strings = (char *)(shm_map + string_offset);
+    // An earlier run may have left a snapshot behind, the magic is written
+    // last so readers never see a half initialized header.
+    memset(shm_header, 0, sizeof(Shm_Header));
+    shm_header->size = shm_size;
+    shm_header->interval = interval.tv_sec * 1000000000UL + interval.tv_nsec;
+    shm_header->cpu_count = CpuCount();
+    shm_header->ring_count = ring_count;
+    shm_header->ring_size = SHM_RING_SIZE;
+    shm_header->ring_head = SHM_RING_SIZE - 1;
+    shm_header->ring_offset = ring_offset;
+    shm_header->proc_offset = proc_offset;
+    shm_header->string_offset = string_offset;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(shm_header->magic, SHM_MAGIC, SHM_MAGIC_SIZE);
+    return true;
+}
+
+void
+ShmStop() {
+    if (shm_map == NULL) {
+        return;
+    }
+    munmap(shm_map, shm_size);
+    shm_unlink(shm_name);
+    free(shm_name);
+    shm_map = NULL;
+}
+
+static void
+ShmAddProc(Proc_Data *proc, void *arg) {
+    Shm_Proc_State *state = arg;
+    if (state->count == SHM_MAX_PROCS) {
+        return;
+    }
+    const char *command = proc->command_line.str;
+    size_t length = Min(strlen(command), (size_t)SHM_COMMAND_LENGTH);
+    // Once the pool is full the remaining processes get no command line.
+    if (state->string_size + length > SHM_STRING_POOL_SIZE) {
+        length = 0;
+    }
+    memcpy(shm_strings + state->string_size, command, length);
+    shm_procs[state->count++] = (Shm_Proc){
+        .pid = proc->pid,
+        .parent = proc->parent,
+        .cpu_time = ps_proc_cpu_time(proc),
+        .memory = (uint64_t)proc->memory << 10,
+        .command_offset = state->string_size,
+        .command_length = length,
+    };
+    state->string_size += length;
+}
+
+void
+ShmPublish() {
+    Shm_Header *h = shm_header;
+    struct timespec now;
+    unsigned long rx, tx;
+    const double seconds = h->interval / 1e9;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    // Seqlock, readers retry while the sequence is odd or has changed.
+    const uint32_t sequence = h->sequence;
+    __atomic_store_n(&h->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    h->time = now.tv_sec * 1000000000UL + now.tv_nsec;
+    const uint32_t head = (h->ring_head + 1) % SHM_RING_SIZE;
+    double *const samples = shm_rings + head;
+    NetworkLastPeriod(&rx, &tx);
+    samples[SHM_RING_CPU_AVERAGE * SHM_RING_SIZE] = CpuUsage(-1);
+    samples[SHM_RING_MEMORY * SHM_RING_SIZE] = MemoryMainUsage();
+    samples[SHM_RING_SWAP * SHM_RING_SIZE]
+        = MemorySwapTotal() ? MemorySwapUsage() : 0.0;
+    samples[SHM_RING_RECEIVE * SHM_RING_SIZE] = rx / seconds;
+    samples[SHM_RING_TRANSMIT * SHM_RING_SIZE] = tx / seconds;
+    for (uint32_t i = 0; i < h->cpu_count; ++i) {
+        samples[(SHM_RING_CPU + i) * SHM_RING_SIZE] = CpuUsage(i);
+    }
+    h->ring_head = head;
+    h->ring_filled = Min(h->ring_filled + 1, (uint32_t)SHM_RING_SIZE);
+
+    h->memory_total = MemoryMainTotal();
+    h->swap_total = MemorySwapTotal();
+    NetworkTotals(&rx, &tx);
+    h->receive_total = rx;
+    h->transmit_total = tx;
+
+    Shm_Proc_State state = {0, 0};
+    ps_for_each(ShmAddProc, &state);
+    h->proc_count = state.count;
+    h->string_size = state.string_size;
+
+    __atomic_store_n(&h->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
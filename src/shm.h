@@ -0,0 +1,14 @@
+#pragma once
+#include "shm_layout.h"
+#include "stdafx.h"
+
+/** Creates the POSIX shared memory object `name` for the collectors of all
+    widgets, which must be set up already.  Prints a message and returns false
+    on failure. */
+bool ShmStart(const char *name);
+
+/** Unmaps and removes the object. */
+void ShmStop();
+
+/** Writes the latest samples and the process list into the snapshot. */
+void ShmPublish();
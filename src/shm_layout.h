@@ -0,0 +1,79 @@
+#pragma once
+// Layout of the snapshot published by `sm --shm=NAME`, kept free of other sm
+// headers so readers can include it on its own (see tools/shm_dump.c).
+//
+// The region starts with a `Shm_Header`, the other parts are at the offsets
+// it gives.  All values use the byte order of the machine.  A reader copies
+// what it needs and checks the sequence number to make sure the copy is
+// consistent:
+//
+//   do {
+//       while ((seq = __atomic_load_n(&h->sequence, __ATOMIC_ACQUIRE)) & 1)
+//           ;
+//       ... copy ...
+//       __atomic_thread_fence(__ATOMIC_ACQUIRE);
+//   } while (__atomic_load_n(&h->sequence, __ATOMIC_RELAXED) != seq);
+#include <stdint.h>
+
+#define SHM_MAGIC "SMSHM\0\0\1"
+#define SHM_MAGIC_SIZE 8
+
+/** Samples kept per ring. */
+#define SHM_RING_SIZE 256
+/** Processes beyond this are left out of the table. */
+#define SHM_MAX_PROCS 8192
+#define SHM_STRING_POOL_SIZE (1 << 20)
+/** Longest command line put into the string pool, in bytes. */
+#define SHM_COMMAND_LENGTH 256
+
+/** Index of the rings, the per CPU rings follow the fixed ones. */
+enum {
+    SHM_RING_CPU_AVERAGE,
+    SHM_RING_MEMORY,
+    SHM_RING_SWAP,
+    /** Bytes per second. */
+    SHM_RING_RECEIVE,
+    SHM_RING_TRANSMIT,
+    SHM_RING_CPU,
+};
+
+typedef struct {
+    char magic[SHM_MAGIC_SIZE];
+    /** Odd while the writer is updating the snapshot. */
+    uint32_t sequence;
+    /** Size of the whole region. */
+    uint32_t size;
+    /** CLOCK_REALTIME of the last update in nanoseconds. */
+    uint64_t time;
+    uint64_t interval;
+    uint32_t cpu_count;
+    /** `SHM_RING_CPU + cpu_count` rings of `ring_size` doubles. */
+    uint32_t ring_count;
+    uint32_t ring_size;
+    /** Index of the latest sample in every ring. */
+    uint32_t ring_head;
+    /** How many samples of the rings are valid, going back from the head. */
+    uint32_t ring_filled;
+    uint32_t ring_offset;
+    uint64_t memory_total;
+    uint64_t swap_total;
+    uint64_t receive_total;
+    uint64_t transmit_total;
+    uint32_t proc_count;
+    uint32_t proc_offset;
+    /** Bytes of the string pool in use. */
+    uint32_t string_size;
+    uint32_t string_offset;
+} Shm_Header;
+
+typedef struct {
+    int32_t pid;
+    int32_t parent;
+    /** In clock ticks, see sysconf(_SC_CLK_TCK). */
+    uint64_t cpu_time;
+    /** Resident set size in bytes. */
+    uint64_t memory;
+    /** Offset into the string pool, the command line is not terminated. */
+    uint32_t command_offset;
+    uint32_t command_length;
+} Shm_Proc;
@@ -1,16 +1,26 @@
 #include "sm.h"
+#include "batch.h"
 #include "battery.h"
+#include "bench.h"
 #include "config.h"
 #include "cpu.h"
 #include "dialog.h"
 #include "disk.h"
+#include "export.h"
+#include "graph.h"
 #include "input.h"
 #include "layout.h"
 #include "layout_parser.h"
 #include "memory.h"
 #include "nc-help/help.h"
 #include "network.h"
+#include "offscreen.h"
 #include "proc.h"
+#include "procfs.h"
+#include "profile.h"
+#include "record.h"
+#include "replay.h"
+#include "serve.h"
 #include "stdafx.h"
 #include "temp.h"
 #include "ui.h"
@@ -46,8 +56,17 @@ static help_text_type help_text = {
     HELP_LABEL("CPU"),
     {"C", "Toggle CPU graph range scaling"},
     {"a", "Toggle average CPU usage"},
+    {"h", "Toggle CPU heatmap"},
+    {"b", "Cycle CPU time breakdown by mode"},
+    HELP_LABEL("Graphs"),
+    {"+/-", "Zoom the time axis in/out"},
+    {"[/]", "Move the time axis backward/forward"},
+    HELP_LABEL("Replay"),
+    {",/.", "Seek backward/forward 10 seconds"},
+    {"</>", "Halve/double the replay speed"},
     HELP_LABEL("GENERAL"),
     {"R", "Reload theme"},
+    {"P", "Toggle profiling overlay"},
     {"q", "Quit"},
     {"?", "Show help"},
 };
@@ -68,6 +87,11 @@ struct Widget *all_widgets[]
 // Widgets used in the layout
 static struct Widget *widgets[countof(all_widgets)];
 
+// Update and draw timings of the widgets, same order as `widgets`
+static Profile_Timer *widget_timers[countof(all_widgets)];
+
+static Profile_Timer *curses_timer;
+
 struct Widget *bottom_right_widget = NULL;
 
 pthread_mutex_t draw_mutex;
@@ -81,8 +105,42 @@ bool (*HandleInput)(int key);
 typedef struct {
     const char *theme_name;
     const char *layout;
+    bool bench;
+    unsigned long bench_iterations;
+    char *const *bench_filters;
+    int bench_filter_count;
+    const char *record_path;
+    const char *replay_path;
+    double replay_speed;
+    bool batch;
+    Batch_Options batch_options;
+    const char *export_address;
+    const char *serve_address;
+    const char *shm_name;
+    const char *attach_address;
+    bool snapshot;
+    bool snapshot_ansi;
 } Arguments;
 
+enum {
+    OPTION_BENCH = 256,
+    OPTION_PROC_ROOT,
+    OPTION_SYS_ROOT,
+    OPTION_RECORD,
+    OPTION_REPLAY,
+    OPTION_SPEED,
+    OPTION_BATCH,
+    OPTION_FORMAT,
+    OPTION_FIELDS,
+    OPTION_TOP,
+    OPTION_COUNT,
+    OPTION_EXPORT,
+    OPTION_SERVE,
+    OPTION_SHM,
+    OPTION_ATTACH,
+    OPTION_SNAPSHOT,
+};
+
 void LoadConfig();
 void LoadTheme(const char *name);
 
@@ -103,19 +161,43 @@ Arguments ParseArgs(int, char *const *);
 
 void HelpShow();
 
+static int Snapshot(const char *theme_name, bool ansi);
+
+/** Set while drawing a `--snapshot`, nothing waits for input then. */
+static bool snapshot_active = false;
+
 static void *
 UpdateThread(void *arg) {
     bool *running = arg;
+    struct timespec delay;
+    uint64_t ns, pan_time;
     while (*running) {
-        UpdateWidgets();
+        delay = interval;
+        if (ReplayActive()) {
+            ns = ReplayStep(widgets);
+            delay.tv_sec = ns / 1000000000UL;
+            delay.tv_nsec = ns % 1000000000UL;
+        } else {
+            // The profile overlay and the zoom and pan keys read the timings
+            // and graphs written here.
+            pthread_mutex_lock(&draw_mutex);
+            UpdateWidgets();
+            pthread_mutex_unlock(&draw_mutex);
+            if (RecordActive()) {
+                RecordFrame(widgets);
+            }
+        }
         pthread_mutex_lock(&draw_mutex);
         DrawWidgets();
+        if (ReplayActive() || GraphPanTime(&pan_time)) {
+            DrawHelpInfo();
+        }
         CursesUpdate();
         if (DrawOverlay) {
             DrawOverlay(overlay_data);
         }
         pthread_mutex_unlock(&draw_mutex);
-        nanosleep(&interval, NULL);
+        nanosleep(&delay, NULL);
     }
     return NULL;
 }
@@ -124,8 +206,45 @@ int
 main(int argc, char *const *argv) {
     ReadConfig();
     LoadConfig();
+    ProcfsInit();
     Arguments arguments = ParseArgs(argc, argv);
 
+    if (arguments.bench) {
+        const int status = Bench(
+            arguments.bench_iterations,
+            arguments.bench_filters,
+            arguments.bench_filter_count
+        );
+        FreeConfig();
+        return status;
+    }
+    const bool serve = arguments.serve_address || arguments.shm_name;
+    if (arguments.batch + !!arguments.export_address + serve > 1) {
+        fputs(
+            "sm: only one of --batch, --export and --serve can be used\n",
+            stderr
+        );
+        FreeConfig();
+        return 1;
+    }
+    if (serve) {
+        const int status
+            = Serve(arguments.serve_address, arguments.shm_name);
+        FreeConfig();
+        return status;
+    }
+    if (arguments.export_address) {
+        const int status
+            = Export(arguments.export_address, &arguments.batch_options);
+        FreeConfig();
+        return status;
+    }
+    if (arguments.batch) {
+        const int status = Batch(&arguments.batch_options);
+        FreeConfig();
+        return status;
+    }
+
     const bool show_current_layout
         = arguments.layout && strcmp(arguments.layout, "?") == 0;
     if (show_current_layout) {
@@ -137,12 +256,46 @@ main(int argc, char *const *argv) {
         return 0;
     }
 
+    if (!!arguments.record_path + !!arguments.replay_path
+            + !!arguments.attach_address
+        > 1) {
+        fputs(
+            "sm: only one of --record, --replay and --attach can be used\n",
+            stderr
+        );
+        FreeConfig();
+        return 1;
+    }
+    if (arguments.record_path && !RecordStart(arguments.record_path)) {
+        FreeConfig();
+        return 1;
+    }
+    if (arguments.replay_path
+        && !ReplayOpen(arguments.replay_path, arguments.replay_speed)) {
+        FreeConfig();
+        return 1;
+    }
+    if (arguments.attach_address && !ReplayAttach(arguments.attach_address)) {
+        FreeConfig();
+        return 1;
+    }
+
     ui = ParseLayoutString(layout);
     UIGetMinSize(ui);
     UICollectWidgets(ui, widgets);
 
     HandleInput = MainHandleInput;
 
+    if (arguments.snapshot) {
+        const int status
+            = Snapshot(arguments.theme_name, arguments.snapshot_ansi);
+        RecordStop();
+        ReplayClose();
+        CleanLayouts();
+        FreeConfig();
+        return status;
+    }
+
     CursesInit();
     LoadTheme(arguments.theme_name);
     UIConstruct(ui);
@@ -170,6 +323,8 @@ main(int argc, char *const *argv) {
     UIDeleteLayout(ui);
     free(theme);
     CursesQuit();
+    RecordStop();
+    ReplayClose();
     CleanLayouts();
     FreeConfig();
 }
@@ -193,6 +348,9 @@ LoadConfig() {
     if ((v = ConfigGet("cpu", "scale-height"))) {
         cpu_scale_height = v->as_bool();
     }
+    if ((v = ConfigGet("cpu", "heatmap"))) {
+        cpu_heatmap = v->as_bool();
+    }
 
     if ((v = ConfigGet("proc", "forest"))) {
         proc_forest = v->as_bool();
@@ -329,6 +487,47 @@ MainHandleInput(int key) {
         HelpShow();
         break;
 
+    case 'P':
+        ProfileToggle();
+        break;
+
+    case ',':
+    case '.':
+        if (ReplayActive()) {
+            ReplaySeek(key == ',' ? -REPLAY_SEEK_STEP : REPLAY_SEEK_STEP);
+        }
+        break;
+
+    case '<':
+    case '>':
+        if (ReplayActive()) {
+            ReplayChangeSpeed(key == '<' ? 0.5 : 2.0);
+        }
+        break;
+
+    case '+':
+    case '-':
+        pthread_mutex_lock(&draw_mutex);
+        if (GraphZoom(key == '+' ? -1 : 1)) {
+            DrawWidgets();
+            DrawBorders();
+            CursesUpdate();
+        }
+        pthread_mutex_unlock(&draw_mutex);
+        break;
+
+    case '[':
+    case ']':
+        pthread_mutex_lock(&draw_mutex);
+        if (GraphPan(key == '[' ? 1 : -1)) {
+            // Drawn first as the time shown while panned comes from drawing.
+            DrawWidgets();
+            DrawBorders();
+            CursesUpdate();
+        }
+        pthread_mutex_unlock(&draw_mutex);
+        break;
+
     case 'R':
         pthread_mutex_lock(&draw_mutex);
         if ((err = ReloadTheme())) {
@@ -383,12 +582,16 @@ CursesInit() {
 
 void
 CursesUpdate() {
+    const uint64_t start = ProfileNow();
     refresh();
     widgets_for_each () {
         if (!w->hidden) {
             wrefresh(w->win);
         }
     }
+    if (curses_timer) {
+        ProfileRecord(&curses_timer->draw, ProfileNow() - start);
+    }
 }
 
 void
@@ -406,22 +609,39 @@ CursesResize() {
 void
 InitWidgets() {
     widgets_for_each () {
+        widget_timers[it - widgets] = ProfileTimer(w->name);
         w->Init(w->win);
     }
+    curses_timer = ProfileTimer("(refresh)");
 }
 
 void
 UpdateWidgets() {
+    uint64_t start;
     widgets_for_each () {
+        // A recording should not have gaps just because the terminal is small.
+        if (w->hidden && w->hidden_update == HIDDEN_UPDATE_SKIP
+            && !RecordActive()) {
+            continue;
+        }
+        start = ProfileNow();
         w->Update();
+        ProfileRecord(
+            &widget_timers[it - widgets]->update, ProfileNow() - start
+        );
     }
 }
 
 void
 DrawWidgets() {
+    uint64_t start;
     widgets_for_each () {
         if (!w->hidden) {
+            start = ProfileNow();
             w->Draw(w->win);
+            ProfileRecord(
+                &widget_timers[it - widgets]->draw, ProfileNow() - start
+            );
         }
     }
 }
@@ -438,8 +658,37 @@ DrawBorders() {
 
 void
 DrawHelpInfo() {
+    char info[96];
     if (bottom_right_widget) {
-        DrawWindowInfo2(bottom_right_widget->win, "Press ? for help");
+        info[0] = '\0';
+        const unsigned factor = GraphZoomFactor();
+        if (factor > 1) {
+            const double seconds
+                = factor * (interval.tv_sec + interval.tv_nsec / 1e9);
+            if (seconds >= 3600.0) {
+                sprintf(info, "%gh per point  ", seconds / 3600.0);
+            } else if (seconds >= 60.0) {
+                sprintf(info, "%gm per point  ", seconds / 60.0);
+            } else {
+                sprintf(info, "%gs per point  ", seconds);
+            }
+        }
+        uint64_t time;
+        if (GraphPanTime(&time)) {
+            const time_t seconds = time / 10;
+            strftime(
+                info + strlen(info),
+                sizeof(info) - strlen(info),
+                "At %H:%M:%S  ",
+                localtime(&seconds)
+            );
+        }
+        if (ReplayActive()) {
+            ReplayStatus(info + strlen(info), sizeof(info) - strlen(info));
+            strcat(info, "  ");
+        }
+        strcat(info, "Press ? for help");
+        DrawWindowInfo2(bottom_right_widget->win, info);
         wrefresh(bottom_right_widget->win);
     }
 }
@@ -476,6 +725,9 @@ TooSmall() {
             }
         }
         refresh();
+        if (snapshot_active) {
+            return;
+        }
         switch (ch = GetChar()) {
         case 'q':
             ungetch('q');
@@ -505,6 +757,40 @@ Usage(FILE *stream) {
     fputs("  -T         Show kernel threads\n", stderr);
     fputs("  -t theme   Specifies the theme, disables all theme changes from the configuration\n", stream);
     fputs("  -h         Show help message\n", stream);
+    fputs("  --proc-root=DIR\n", stream);
+    fputs("             Read process and system information from DIR instead of /proc\n", stream);
+    fputs("  --sys-root=DIR\n", stream);
+    fputs("             Read device information from DIR instead of /sys\n", stream);
+    fputs("  --record=FILE\n", stream);
+    fputs("             Append the samples of all widgets in the layout to FILE\n", stream);
+    fputs("  --replay=FILE\n", stream);
+    fputs("             Show the samples recorded in FILE instead of live data\n", stream);
+    fputs("  --speed=N  Replay speed factor, 0 replays as fast as possible\n", stream);
+    fputs("  --serve=PATH\n", stream);
+    fputs("             Collect once for any number of --attach clients on the Unix socket\n", stream);
+    fputs("             PATH instead of drawing widgets\n", stream);
+    fputs("  --shm=NAME Publish the samples of all widgets to the shared memory object\n", stream);
+    fputs("             NAME instead of drawing widgets, can be combined with --serve\n", stream);
+    fputs("  --attach=PATH\n", stream);
+    fputs("             Show the samples of the --serve process listening on PATH\n", stream);
+    fputs("  --batch    Print one record per update to stdout instead of drawing widgets\n", stream);
+    fputs("  --format=csv|json\n", stream);
+    fputs("             Format of the --batch records, defaults to csv\n", stream);
+    fputs("  --fields=LIST\n", stream);
+    fputs("             Comma separated values to include in --batch records: cpu, cpus,\n", stream);
+    fputs("             memory, swap, network, disk, temp, procs or all (the default)\n", stream);
+    fputs("  --top=N    Number of processes in --batch records, defaults to 10\n", stream);
+    fputs("  --count=N  Exit after N --batch records, 0 (the default) runs until killed\n", stream);
+    fputs("  --export=PORT|PATH\n", stream);
+    fputs("             Serve the --fields and --top processes as Prometheus metrics on\n", stream);
+    fputs("             127.0.0.1:PORT or the Unix socket PATH instead of drawing widgets\n", stream);
+    fputs("  --snapshot[=text|ansi]\n", stream);
+    fputs("             Draw the layout once to an offscreen terminal of $COLUMNS x $LINES\n", stream);
+    fputs("             cells (80x24 if unset) and print it to stdout as plain text (the\n", stream);
+    fputs("             default) or with ANSI colors, with --replay the first frames are used\n", stream);
+    fputs("  --bench[=N] [NAME...]\n", stream);
+    fputs("             Benchmark the collectors and graph drawing with N iterations each\n", stream);
+    fputs("             and exit, only benchmarks containing one of the NAMEs are run\n", stream);
     fputc('\n', stream);
     fputs("If the layout option for -l is '?' the default layout string gets printed.\n", stream);
     // clang-format on
@@ -512,13 +798,55 @@ Usage(FILE *stream) {
 
 Arguments
 ParseArgs(int argc, char *const *argv) {
-    char opt;
+    static const struct option long_options[] = {
+        {"bench", optional_argument, NULL, OPTION_BENCH},
+        {"proc-root", required_argument, NULL, OPTION_PROC_ROOT},
+        {"sys-root", required_argument, NULL, OPTION_SYS_ROOT},
+        {"record", required_argument, NULL, OPTION_RECORD},
+        {"replay", required_argument, NULL, OPTION_REPLAY},
+        {"speed", required_argument, NULL, OPTION_SPEED},
+        {"batch", no_argument, NULL, OPTION_BATCH},
+        {"format", required_argument, NULL, OPTION_FORMAT},
+        {"fields", required_argument, NULL, OPTION_FIELDS},
+        {"top", required_argument, NULL, OPTION_TOP},
+        {"count", required_argument, NULL, OPTION_COUNT},
+        {"export", required_argument, NULL, OPTION_EXPORT},
+        {"serve", required_argument, NULL, OPTION_SERVE},
+        {"shm", required_argument, NULL, OPTION_SHM},
+        {"attach", required_argument, NULL, OPTION_ATTACH},
+        {"snapshot", optional_argument, NULL, OPTION_SNAPSHOT},
+        {NULL, 0, NULL, 0},
+    };
+    int opt;
     unsigned long n;
     Arguments result = {
         .theme_name = NULL,
         .layout = NULL,
+        .bench = false,
+        .bench_iterations = BENCH_DEFAULT_ITERATIONS,
+        .bench_filters = NULL,
+        .bench_filter_count = 0,
+        .record_path = NULL,
+        .replay_path = NULL,
+        .replay_speed = 1.0,
+        .batch = false,
+        .batch_options = {
+            .format = BATCH_FORMAT_CSV,
+            .fields = BATCH_FIELD_ALL,
+            .top = BATCH_DEFAULT_TOP,
+            .count = 0,
+        },
+        .export_address = NULL,
+        .serve_address = NULL,
+        .shm_name = NULL,
+        .attach_address = NULL,
+        .snapshot = false,
+        .snapshot_ansi = false,
     };
-    while ((opt = getopt(argc, argv, "ar:h?s:cfl:Tt:")) != -1) {
+    while ((opt = getopt_long(
+                argc, argv, "ar:h?s:cfl:Tt:", long_options, NULL
+            ))
+           != -1) {
         switch (opt) {
         case 'a':
             cpu_show_avg = true;
@@ -550,6 +878,89 @@ ParseArgs(int argc, char *const *argv) {
             result.theme_name = optarg;
             break;
 
+        case OPTION_BENCH:
+            result.bench = true;
+            if (optarg) {
+                result.bench_iterations = strtoul(optarg, NULL, 10);
+            }
+            break;
+
+        case OPTION_PROC_ROOT:
+            procfs_root = optarg;
+            break;
+
+        case OPTION_SYS_ROOT:
+            sysfs_root = optarg;
+            break;
+
+        case OPTION_RECORD:
+            result.record_path = optarg;
+            break;
+
+        case OPTION_REPLAY:
+            result.replay_path = optarg;
+            break;
+
+        case OPTION_SPEED:
+            result.replay_speed = strtod(optarg, NULL);
+            if (result.replay_speed < 0.0) {
+                Usage(stderr);
+                exit(1);
+            }
+            break;
+
+        case OPTION_BATCH:
+            result.batch = true;
+            break;
+
+        case OPTION_FORMAT:
+            if (!BatchParseFormat(optarg, &result.batch_options.format)) {
+                Usage(stderr);
+                exit(1);
+            }
+            break;
+
+        case OPTION_FIELDS:
+            if (!BatchParseFields(optarg, &result.batch_options.fields)) {
+                Usage(stderr);
+                exit(1);
+            }
+            break;
+
+        case OPTION_TOP:
+            result.batch_options.top = strtoul(optarg, NULL, 10);
+            break;
+
+        case OPTION_COUNT:
+            result.batch_options.count = strtoul(optarg, NULL, 10);
+            break;
+
+        case OPTION_EXPORT:
+            result.export_address = optarg;
+            break;
+
+        case OPTION_SERVE:
+            result.serve_address = optarg;
+            break;
+
+        case OPTION_SHM:
+            result.shm_name = optarg;
+            break;
+
+        case OPTION_ATTACH:
+            result.attach_address = optarg;
+            break;
+
+        case OPTION_SNAPSHOT:
+            result.snapshot = true;
+            if (optarg && strcmp(optarg, "ansi") == 0) {
+                result.snapshot_ansi = true;
+            } else if (optarg && strcmp(optarg, "text") != 0) {
+                Usage(stderr);
+                exit(1);
+            }
+            break;
+
         case 'h':
         case '?':
             Usage(stdout);
@@ -560,6 +971,10 @@ ParseArgs(int argc, char *const *argv) {
             exit(1);
         }
     }
+    if (result.bench) {
+        result.bench_filters = argv + optind;
+        result.bench_filter_count = argc - optind;
+    }
     return result;
 }
 
@@ -641,3 +1056,40 @@ break_out:;
         ungetch(KEY_REFRESH);
     }
 }
+
+/** Draws the layout once onto an offscreen terminal and prints it.  The
+    widgets are updated twice first so rates have something to compare to. */
+static int
+Snapshot(const char *theme_name, bool ansi) {
+    if (!OffscreenStart(0, 0)) {
+        return 1;
+    }
+    snapshot_active = true;
+    LoadTheme(theme_name);
+    UIConstruct(ui);
+    InitWidgets();
+    UIUpdateSizeInfo(ui, true);
+    for (int i = 0; i < 2; ++i) {
+        if (ReplayActive()) {
+            ReplayStep(widgets);
+        } else {
+            if (i > 0) {
+                nanosleep(&interval, NULL);
+            }
+            UpdateWidgets();
+        }
+    }
+    if (ui_too_small) {
+        TooSmall();
+    } else {
+        DrawBorders();
+        DrawWidgets();
+        CursesUpdate();
+    }
+    OffscreenDump(curscr, stdout, ansi);
+    UIDeleteLayout(ui);
+    free(theme);
+    OffscreenStop();
+    snapshot_active = false;
+    return 0;
+}
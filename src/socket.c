@@ -0,0 +1,111 @@
+#include "socket.h"
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+typedef union {
+    struct sockaddr sa;
+    struct sockaddr_un un;
+    struct sockaddr_in in;
+} Socket_Address;
+
+static bool
+SocketIsUnix(const char *address) {
+    return strchr(address, '/') != NULL;
+}
+
+/** Parses the address, prints a message and returns 0 if it is invalid. */
+static socklen_t
+SocketParse(const char *address, Socket_Address *result) {
+    memset(result, 0, sizeof(*result));
+    if (SocketIsUnix(address)) {
+        if (strlen(address) >= sizeof(result->un.sun_path)) {
+            fprintf(stderr, "sm: %s: socket path too long\n", address);
+            return 0;
+        }
+        result->un.sun_family = AF_UNIX;
+        strcpy(result->un.sun_path, address);
+        return sizeof(result->un);
+    }
+    char *end;
+    const unsigned long port = strtoul(address, &end, 10);
+    if (*address == '\0' || *end || port == 0 || port > 65535) {
+        fprintf(stderr, "sm: %s: not a port or socket path\n", address);
+        return 0;
+    }
+    result->in.sin_family = AF_INET;
+    result->in.sin_port = htons(port);
+    result->in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return sizeof(result->in);
+}
+
+/** Returns true if nothing listens on the Unix socket anymore. */
+static bool
+SocketIsStale(const Socket_Address *sa, socklen_t size) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    const bool stale
+        = connect(fd, &sa->sa, size) != 0 && errno == ECONNREFUSED;
+    close(fd);
+    return stale;
+}
+
+int
+SocketListen(const char *address) {
+    Socket_Address sa;
+    struct stat st;
+    const socklen_t size = SocketParse(address, &sa);
+    if (size == 0) {
+        return -1;
+    }
+    if (SocketIsUnix(address) && lstat(address, &st) == 0
+        && S_ISSOCK(st.st_mode)) {
+        if (!SocketIsStale(&sa, size)) {
+            fprintf(stderr, "sm: %s: address in use\n", address);
+            return -1;
+        }
+        unlink(address);
+    }
+    const int fd = socket(sa.sa.sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && sa.sa.sa_family == AF_INET) {
+        const int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    }
+    if (fd < 0 || bind(fd, &sa.sa, size) != 0 || listen(fd, 16) != 0) {
+        fprintf(stderr, "sm: %s: %s\n", address, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+int
+SocketConnect(const char *address) {
+    Socket_Address sa;
+    const socklen_t size = SocketParse(address, &sa);
+    if (size == 0) {
+        return -1;
+    }
+    const int fd = socket(sa.sa.sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, &sa.sa, size) != 0) {
+        fprintf(stderr, "sm: %s: %s\n", address, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+void
+SocketClose(int fd, const char *address) {
+    close(fd);
+    if (SocketIsUnix(address)) {
+        unlink(address);
+    }
+}
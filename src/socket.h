@@ -0,0 +1,15 @@
+#pragma once
+#include "stdafx.h"
+
+/** Creates a listening stream socket, on the Unix socket `address` if it
+    contains a slash and on that port of 127.0.0.1 otherwise.  A socket file
+    left behind by an earlier run is replaced, one that is still listened on
+    or any other file is not.  Prints a message and returns -1 on failure. */
+int SocketListen(const char *address);
+
+/** Connects to an address as understood by `SocketListen`.  Prints a message
+    and returns -1 on failure. */
+int SocketConnect(const char *address);
+
+/** Closes a socket created by `SocketListen` and removes its file. */
+void SocketClose(int fd, const char *address);
@@ -13,7 +13,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <float.h>
-#include <ifaddrs.h>
+#include <getopt.h>
 #include <inttypes.h>
 #include <locale.h>
 #include <math.h>
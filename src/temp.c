@@ -1,5 +1,8 @@
 #include "temp.h"
+#include "procfs.h"
 #include "ps/util.h"
+#include "record.h"
+#include "replay.h"
 #include "util.h"
 
 IgnoreInput(Temp);
@@ -14,6 +17,7 @@ typedef struct {
     char *type;
     // size is determined by the compiler warning after using a very small value
     char temp[15];
+    int millidegrees;
     int number;  // for sorting
 } ThermalZone;
 
@@ -41,13 +45,17 @@ TempCompareZone(const void *a, const void *b) {
 
 static void
 TempDiscover(VECTOR(char *) filter) {
-    const char *BASE_PATH = "/sys/class/thermal";
-    DIR *dir = opendir(BASE_PATH);
+    char *base_path = Format("%s/class/thermal", sysfs_root);
+    DIR *dir = opendir(base_path);
     struct dirent *entry = NULL;
     const char CHECK[] = "thermal_zone";
+    if (dir == NULL) {
+        free(base_path);
+        return;
+    }
     while ((entry = readdir(dir))) {
         if (strncmp(entry->d_name, CHECK, sizeof(CHECK) - 1) == 0) {
-            char *path = Format("%s/%s/type", BASE_PATH, entry->d_name);
+            char *path = Format("%s/%s/type", base_path, entry->d_name);
             char *type = ReadSmallFile(path, true);
             if (TempFilter(entry->d_name, filter) || TempFilter(type, filter)) {
                 memcpy(path + strlen(path) - 4, "temp", 4);
@@ -63,6 +71,8 @@ TempDiscover(VECTOR(char *) filter) {
             }
         }
     }
+    closedir(dir);
+    free(base_path);
     if (zones) {
         qsort(zones, vector_size(zones), sizeof(*zones), TempCompareZone);
     }
@@ -92,37 +102,88 @@ static VECTOR(char *) TempGetFilter(const char *filter_string) {
     return filter;
 }
 
+/** Creates the zones from the first zone information in the replayed file,
+    the filter was already applied when recording. */
+static bool
+TempReplayDiscover() {
+    Frame_Reader recorded;
+    if (!ReplayPeek(RECORD_TEMP_INFO, &recorded)) {
+        return false;
+    }
+    const size_t count = FrameGetVarint(&recorded);
+    for (size_t i = 0; i < count && !recorded.error; ++i) {
+        vector_emplace_back(
+            zones,
+            .temp_path = NULL,
+            .type = FrameGetString(&recorded),
+            .temp = "",
+            .number = i
+        );
+    }
+    return true;
+}
+
 void
-TempInit(WINDOW *win) {
+TempCollectorInit() {
     zones = vector_create(ThermalZone, 4);
     memset(zones, 0, 4 * sizeof(ThermalZone));
+    if (ReplayActive() && TempReplayDiscover()) {
+        return;
+    }
     VECTOR(char *) filter = TempGetFilter(temp_filter);
     TempDiscover(filter);
     vector_free(filter);
-    TempDrawBorder(win);
-    WidgetFixedSize(&temp_widget, true);
 }
 
 void
-TempQuit() {
+TempCollectorQuit() {
     vector_for_each (zones, zone) {
         free(zone->temp_path);
         free(zone->type);
     }
     vector_free(zones);
+    zones = NULL;
+}
+
+size_t
+TempCount() {
+    return vector_size(zones);
+}
+
+const char *
+TempZoneType(size_t n) {
+    return zones[n].type;
+}
+
+int
+TempZoneMillidegrees(size_t n) {
+    return zones[n].millidegrees;
 }
 
 void
-TempUpdate() {
-    uint64_t total = 0;
-    vector_for_each (zones, zone) {
-        const int sample = atoi(ReadSmallFile(zone->temp_path, true));
-        const int whole = sample / 1000;
-        const int decimal = sample % 1000 / 100;
-        total += sample / 100;
-        snprintf(zone->temp, sizeof(zone->temp), "%5d.%d°C", whole, decimal);
-    }
-    if (temp_show_average) {
+TempInit(WINDOW *win) {
+    TempCollectorInit();
+    TempDrawBorder(win);
+    WidgetFixedSize(&temp_widget, true);
+}
+
+void
+TempQuit() {
+    TempCollectorQuit();
+}
+
+static void
+TempSetSample(ThermalZone *zone, int sample) {
+    const int whole = sample / 1000;
+    const int decimal = sample % 1000 / 100;
+    zone->millidegrees = sample;
+    snprintf(zone->temp, sizeof(zone->temp), "%5d.%d°C", whole, decimal);
+}
+
+/** Updates the average temperature, `total` is in tenths of a degree. */
+static void
+TempSetAverage(uint64_t total) {
+    if (temp_show_average && !vector_empty(zones)) {
         const size_t count = vector_size(zones);
         const uint64_t average = (total + count / 2) / count;
         const int whole = average / 10;
@@ -133,6 +194,53 @@ TempUpdate() {
     }
 }
 
+void
+TempUpdate() {
+    uint64_t total = 0;
+    vector_for_each (zones, zone) {
+        const int sample = atoi(ReadSmallFile(zone->temp_path, true));
+        TempSetSample(zone, sample);
+        total += sample / 100;
+    }
+    TempSetAverage(total);
+}
+
+void
+TempRecord(Frame *frame, bool keyframe) {
+    size_t mark;
+    if (keyframe) {
+        mark = RecordBegin(frame, RECORD_TEMP_INFO);
+        FramePutVarint(frame, vector_size(zones));
+        vector_for_each (zones, zone) {
+            FramePutString(frame, zone->type);
+        }
+        RecordEnd(frame, mark);
+    }
+    mark = RecordBegin(frame, RECORD_TEMP);
+    FramePutVarint(frame, vector_size(zones));
+    vector_for_each (zones, zone) {
+        FramePutSvarint(frame, zone->millidegrees);
+    }
+    RecordEnd(frame, mark);
+}
+
+void
+TempReplay(Frame_Reader *reader, int type) {
+    if (type != RECORD_TEMP) {
+        return;
+    }
+    const size_t count = FrameGetVarint(reader);
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const int sample = FrameGetSvarint(reader);
+        if (i < vector_size(zones)) {
+            TempSetSample(&zones[i], sample);
+            total += sample / 100;
+        }
+    }
+    TempSetAverage(total);
+}
+
 void
 TempDraw(WINDOW *win) {
     int width = getmaxx(win) - 2;
@@ -7,6 +7,18 @@ extern bool temp_show_average;
 
 extern Widget temp_widget;
 
+/** Sets up the data collection without any of the UI, `TempUpdate` may be
+    called after this. */
+void TempCollectorInit();
+void TempCollectorQuit();
+
+/** Returns the number of thermal zones. */
+size_t TempCount();
+/** Returns the type of the n-th thermal zone. */
+const char *TempZoneType(size_t n);
+/** Returns the temperature of the n-th thermal zone from the last update. */
+int TempZoneMillidegrees(size_t n);
+
 void TempInit(WINDOW *win);
 void TempQuit();
 void TempUpdate();
@@ -14,3 +26,5 @@ void TempDraw(WINDOW *win);
 void TempResize(WINDOW *win);
 void TempMinSize(int *width_return, int *height_return);
 void TempDrawBorder(WINDOW *win);
+void TempRecord(Frame *frame, bool keyframe);
+void TempReplay(Frame_Reader *reader, int type);
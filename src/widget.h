@@ -1,4 +1,5 @@
 #pragma once
+#include "frame.h"
 #include "input.h"
 #include "stdafx.h"
 
@@ -8,10 +9,21 @@ enum {
     FIXED_SIZE_SET = false + true + 1
 };
 
+/** What `UpdateWidgets` does with a widget while the layout hides it. */
+enum {
+    /** Don't collect anything, the widget catches up once it's shown again.
+     */
+    HIDDEN_UPDATE_SKIP,
+    /** Keep collecting so there is no gap in the widget's history, this is
+        meant for widgets whose update only feeds cheap graph samples. */
+    HIDDEN_UPDATE_HISTORY,
+};
+
 typedef struct Widget {
     const char *const name;
     WINDOW *win;
     int fixed_size;
+    int hidden_update;
     bool hidden;
     bool exists;
     void (*Init)(WINDOW *win);
@@ -23,15 +35,23 @@ typedef struct Widget {
     bool (*HandleInput)(int key);
     void (*HandleMouse)(Mouse_Event *event);
     void (*DrawBorder)(WINDOW *win);
+    /** Encodes the latest samples for `--record`.  On keyframes everything
+        needed to start decoding at this frame must be included as well. */
+    void (*Record)(Frame *frame, bool keyframe);
+    /** Applies a record from `--replay` in place of `Update`.  Records of
+        other types must be ignored. */
+    void (*Replay)(Frame_Reader *reader, int type);
 } Widget;
 
 #define WIDGET(ident, name_)                                                   \
     (Widget) {                                                                 \
         .name = ident, .win = NULL, .hidden = false, .exists = false,          \
-        .fixed_size = FIXED_SIZE_NO, .Init = name_##Init, .Quit = name_##Quit, \
+        .fixed_size = FIXED_SIZE_NO, .hidden_update = HIDDEN_UPDATE_SKIP,      \
+        .Init = name_##Init, .Quit = name_##Quit,                              \
         .Update = name_##Update, .Draw = name_##Draw, .Resize = name_##Resize, \
         .MinSize = name_##MinSize, .HandleInput = name_##HandleInput,          \
-        .HandleMouse = name_##HandleMouse, .DrawBorder = name_##DrawBorder     \
+        .HandleMouse = name_##HandleMouse, .DrawBorder = name_##DrawBorder,    \
+        .Record = name_##Record, .Replay = name_##Replay                       \
     }
 
 #define IgnoreInput(name_)             \
@@ -45,7 +65,24 @@ typedef struct Widget {
         (void)event;                              \
     }
 
+#define IgnoreRecord(name_)                           \
+    void name_##Record(Frame *frame, bool keyframe) { \
+        (void)frame;                                  \
+        (void)keyframe;                               \
+    }
+
+#define IgnoreReplay(name_)                              \
+    void name_##Replay(Frame_Reader *reader, int type) { \
+        (void)reader;                                    \
+        (void)type;                                      \
+    }
+
 static inline void
 WidgetFixedSize(Widget *widget, bool yay_or_nay) {
     widget->fixed_size = yay_or_nay ? FIXED_SIZE_SET : FIXED_SIZE_NO;
 }
+
+static inline void
+WidgetHiddenUpdate(Widget *widget, int mode) {
+    widget->hidden_update = mode;
+}
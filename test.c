@@ -0,0 +1,27 @@
+#include "series.h"
+#include <math.h>
+int main(){
+  Series s; SeriesConstruct(&s);
+  srand(1);
+  enum{N=200000};
+  static double vals[N]; static uint64_t times[N];
+  double v=0.5; uint64_t t=10000000;
+  for(int i=0;i<N;i++){
+    v += (rand()%2001-1000)/100000.0; if(v<0)v=0; if(v>1)v=1;
+    if(i%5000==0) v = -3.25e7*(i%3);
+    t += 10 + (rand()%7==0 ? (rand()%5000)-2500 : 0);
+    if (i%10007==0) t += 100000000ull;
+    vals[i]=v; times[i]=t; SeriesAppend(&s,t,v);
+  }
+  printf("count %zu size %zu bytes/sample %.3f\n", s.count, SeriesSize(&s), (double)SeriesSize(&s)/s.count);
+  size_t first = N - s.count; int bad=0;
+  for (size_t start=0; start < s.count; start += 977) {
+    Series_Reader r; if(!SeriesSeek(&s,&r,start)){printf("seek fail %zu\n",start);bad++;continue;}
+    for (size_t i=start;i<s.count && i<start+3000;i++){ uint64_t tt; double vv;
+      if(!SeriesNext(&r,&tt,&vv)){printf("next fail at %zu\n",i);bad++;break;}
+      double e=vals[first+i];
+      if(tt!=times[first+i] || fabs(vv-e) > fabs(e)*1e-3+1e-12){ if(bad<5)printf("mismatch %zu t %lu/%lu v %g/%g\n",i,tt,times[first+i],vv,e); bad++; break;}
+    }
+  }
+  printf("bad %d\n",bad);
+}
@@ -0,0 +1,64 @@
+// Counts the allocations made while `sm --bench` measures a benchmark.  Only
+// linked into the binary built by `make bench`:
+//
+//   make bench BENCHARGS=graph
+//
+// The allocator entry points of the executable take precedence over the ones
+// of libc, they count and pass the call on to glibc's own implementation.  The
+// `sm` binary has none of this, its benchmarks show `-` as allocation count.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+bool bench_counting = false;
+unsigned long bench_allocations = 0;
+
+void *
+malloc(size_t size) {
+    bench_allocations += bench_counting;
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t count, size_t size) {
+    bench_allocations += bench_counting;
+    return __libc_calloc(count, size);
+}
+
+void *
+realloc(void *ptr, size_t size) {
+    bench_allocations += bench_counting;
+    return __libc_realloc(ptr, size);
+}
+
+void *
+aligned_alloc(size_t alignment, size_t size) {
+    bench_allocations += bench_counting;
+    return __libc_memalign(alignment, size);
+}
+
+void *
+memalign(size_t alignment, size_t size) {
+    bench_allocations += bench_counting;
+    return __libc_memalign(alignment, size);
+}
+
+int
+posix_memalign(void **out, size_t alignment, size_t size) {
+    if (alignment < sizeof(void *) || (alignment & (alignment - 1))) {
+        return EINVAL;
+    }
+    bench_allocations += bench_counting;
+    void *ptr = __libc_memalign(alignment, size);
+    if (ptr == NULL) {
+        return ENOMEM;
+    }
+    *out = ptr;
+    return 0;
+}
@@ -0,0 +1,639 @@
+// Generates a fake procfs and sysfs tree for testing sm with large or
+// unusual process trees:
+//
+//   make procfs_gen
+//   ./procfs_gen -n 100000 -s random -c 500 -k -1 /tmp/fake &
+//   ./sm --proc-root=/tmp/fake/proc --sys-root=/tmp/fake/sys
+//
+// Only the files sm reads are written.  Every file is replaced atomically and
+// new process directories are filled before they get their final name, so sm
+// never sees partial data while the generator is running.  Putting the tree on
+// a tmpfs is recommended for large process counts.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PID_MAX 4194304
+#define USER_HZ 100
+
+typedef enum {
+    SHAPE_FLAT,
+    SHAPE_DEEP,
+    SHAPE_BALANCED,
+    SHAPE_RANDOM,
+} Shape;
+
+typedef struct {
+    unsigned process_count;
+    Shape shape;
+    unsigned depth;
+    unsigned fanout;
+    unsigned churn;
+    unsigned active_percent;
+    unsigned cpu_count;
+    unsigned interface_count;
+    unsigned zone_count;
+    unsigned long memory_mib;
+    long steps;
+    unsigned interval_ms;
+    uint64_t seed;
+    const char *root;
+} Options;
+
+/** A process slot, slots keep their position in the tree when the process in
+    them is replaced. */
+typedef struct {
+    int pid;
+    unsigned parent;
+    unsigned children;
+    unsigned command;
+    unsigned long utime;
+    unsigned long stime;
+    unsigned long start_time;
+    long rss_pages;
+} Process;
+
+typedef struct {
+    unsigned long user;
+    unsigned long system;
+    unsigned long idle;
+} Cpu_Times;
+
+static const char *gen_commands[] = {
+    "bash", "sshd", "python3", "node", "postgres", "nginx", "java",
+    "containerd-shim", "sleep", "cron", "redis-server", "systemd",
+};
+
+static Options gen_options;
+static Process *gen_procs;
+static uint8_t *gen_used_pids;
+static int gen_next_pid;
+static Cpu_Times *gen_cpus;
+static unsigned long *gen_rx_bytes;
+static unsigned long *gen_tx_bytes;
+static unsigned long gen_memory_used;
+static unsigned long gen_ticks;
+static uint64_t gen_random_state;
+static char *gen_proc_dir;
+static char *gen_sys_dir;
+
+static void
+Die(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    fputs("procfs_gen: ", stderr);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+static void
+DieErrno(const char *what, const char *path) {
+    Die("%s %s: %s", what, path, strerror(errno));
+}
+
+static char *
+Format(const char *fmt, ...) {
+    va_list ap;
+    char *result;
+    va_start(ap, fmt);
+    if (vasprintf(&result, fmt, ap) < 0) {
+        Die("out of memory");
+    }
+    va_end(ap);
+    return result;
+}
+
+/** xorshift64*, so trees are the same for a given seed on every libc. */
+static uint64_t
+Random() {
+    gen_random_state ^= gen_random_state >> 12;
+    gen_random_state ^= gen_random_state << 25;
+    gen_random_state ^= gen_random_state >> 27;
+    return gen_random_state * 0x2545F4914F6CDD1DULL;
+}
+
+static unsigned long
+RandomBelow(unsigned long n) {
+    return n ? Random() % n : 0;
+}
+
+static void
+MakeDir(const char *path) {
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        DieErrno("mkdir", path);
+    }
+}
+
+static void
+WriteFile(const char *path, const char *data, size_t size) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL || fwrite(data, 1, size, f) != size || fclose(f) != 0) {
+        DieErrno("write", path);
+    }
+}
+
+/** Writes the file under a temporary name and renames it so readers only see
+    complete contents. */
+static void
+ReplaceFile(const char *dir, const char *name, const char *data, size_t size) {
+    char *tmp = Format("%s/.%s.tmp", dir, name);
+    char *path = Format("%s/%s", dir, name);
+    WriteFile(tmp, data, size);
+    if (rename(tmp, path) != 0) {
+        DieErrno("rename", path);
+    }
+    free(tmp);
+    free(path);
+}
+
+static void
+ReplaceFileF(const char *dir, const char *name, const char *fmt, ...) {
+    char *data;
+    va_list ap;
+    va_start(ap, fmt);
+    const int size = vasprintf(&data, fmt, ap);
+    va_end(ap);
+    if (size < 0) {
+        Die("out of memory");
+    }
+    ReplaceFile(dir, name, data, size);
+    free(data);
+}
+
+static int
+AllocatePid() {
+    for (;;) {
+        if (gen_next_pid >= PID_MAX) {
+            gen_next_pid = 2;
+        }
+        const int pid = gen_next_pid++;
+        if (!(gen_used_pids[pid / 8] & (1 << (pid % 8)))) {
+            gen_used_pids[pid / 8] |= 1 << (pid % 8);
+            return pid;
+        }
+    }
+}
+
+static void
+FreePid(int pid) {
+    gen_used_pids[pid / 8] &= ~(1 << (pid % 8));
+}
+
+static unsigned
+ParentSlot(unsigned slot) {
+    if (slot == 0) {
+        return 0;
+    }
+    switch (gen_options.shape) {
+    case SHAPE_FLAT:
+        return 0;
+    case SHAPE_DEEP:
+        // Chains of `depth` processes hanging off init.
+        return (slot - 1) % gen_options.depth == 0 ? 0 : slot - 1;
+    case SHAPE_BALANCED:
+        return (slot - 1) / gen_options.fanout;
+    case SHAPE_RANDOM:
+        return RandomBelow(slot);
+    }
+    return 0;
+}
+
+static void
+WriteStat(const char *dir, const Process *p) {
+    const char *comm = gen_commands[p->command];
+    const int ppid = p == gen_procs ? 0 : gen_procs[p->parent].pid;
+    ReplaceFileF(
+        dir,
+        "stat",
+        "%d (%.15s) S %d %d %d 0 -1 4194560 100 0 0 0 %lu %lu 0 0 20 0 1 0 "
+        "%lu %lu %ld 18446744073709551615 0 0 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 "
+        "0 0\n",
+        p->pid,
+        comm,
+        ppid,
+        p->pid,
+        p->pid,
+        p->utime,
+        p->stime,
+        p->start_time,
+        (unsigned long)p->rss_pages * 4096 * 4,
+        p->rss_pages
+    );
+}
+
+/** Creates the directory of a new process, it is filled under a hidden name
+    first since sm only looks at numeric directory names. */
+static void
+SpawnProcess(unsigned slot) {
+    Process *p = &gen_procs[slot];
+    p->pid = AllocatePid();
+    p->command = RandomBelow(sizeof(gen_commands) / sizeof(gen_commands[0]));
+    p->utime = 0;
+    p->stime = 0;
+    p->start_time = gen_ticks;
+    p->rss_pages = 256 + RandomBelow(64 * 1024);
+
+    char *staging = Format("%s/.%d", gen_proc_dir, p->pid);
+    char *final = Format("%s/%d", gen_proc_dir, p->pid);
+    MakeDir(staging);
+    WriteStat(staging, p);
+    const char *comm = gen_commands[p->command];
+    // Arguments are separated and terminated by null bytes.
+    char *cmdline
+        = Format("/usr/bin/%s\n--worker=%u\nconfig.%d\n", comm, slot, p->pid);
+    const size_t cmdline_size = strlen(cmdline);
+    for (char *c = cmdline; (c = strchr(c, '\n')); ++c) {
+        *c = '\0';
+    }
+    ReplaceFile(staging, "cmdline", cmdline, cmdline_size);
+    ReplaceFileF(staging, "comm", "%.15s\n", comm);
+    if (rename(staging, final) != 0) {
+        DieErrno("rename", final);
+    }
+    free(cmdline);
+    free(staging);
+    free(final);
+}
+
+static void
+RemoveProcess(unsigned slot) {
+    Process *p = &gen_procs[slot];
+    char *dead = Format("%s/.dead%d", gen_proc_dir, p->pid);
+    char *path = Format("%s/%d", gen_proc_dir, p->pid);
+    if (rename(path, dead) != 0) {
+        DieErrno("rename", path);
+    }
+    static const char *files[] = {"stat", "cmdline", "comm"};
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+        char *file = Format("%s/%s", dead, files[i]);
+        unlink(file);
+        free(file);
+    }
+    if (rmdir(dead) != 0) {
+        DieErrno("rmdir", dead);
+    }
+    FreePid(p->pid);
+    free(dead);
+    free(path);
+}
+
+static void
+WriteProcStat() {
+    size_t size = 0;
+    char *data = NULL;
+    FILE *f = open_memstream(&data, &size);
+    Cpu_Times total = {0, 0, 0};
+    for (unsigned i = 0; i < gen_options.cpu_count; ++i) {
+        total.user += gen_cpus[i].user;
+        total.system += gen_cpus[i].system;
+        total.idle += gen_cpus[i].idle;
+    }
+    fprintf(
+        f,
+        "cpu  %lu 0 %lu %lu 0 0 0 0 0 0\n",
+        total.user,
+        total.system,
+        total.idle
+    );
+    for (unsigned i = 0; i < gen_options.cpu_count; ++i) {
+        fprintf(
+            f,
+            "cpu%u %lu 0 %lu %lu 0 0 0 0 0 0\n",
+            i,
+            gen_cpus[i].user,
+            gen_cpus[i].system,
+            gen_cpus[i].idle
+        );
+    }
+    fprintf(
+        f,
+        "intr 0\nctxt 0\nbtime 0\nprocesses %d\nprocs_running 1\n"
+        "procs_blocked 0\nsoftirq 0\n",
+        gen_next_pid
+    );
+    fclose(f);
+    ReplaceFile(gen_proc_dir, "stat", data, size);
+    free(data);
+}
+
+static void
+WriteMeminfo() {
+    const unsigned long total = gen_options.memory_mib * 1024;
+    const unsigned long available = total - gen_memory_used;
+    const unsigned long swap_total = total / 4;
+    ReplaceFileF(
+        gen_proc_dir,
+        "meminfo",
+        "MemTotal:       %lu kB\n"
+        "MemFree:        %lu kB\n"
+        "MemAvailable:   %lu kB\n"
+        "Buffers:        %lu kB\n"
+        "Cached:         %lu kB\n"
+        "SwapCached:     0 kB\n"
+        "SwapTotal:      %lu kB\n"
+        "SwapFree:       %lu kB\n"
+        "Shmem:          %lu kB\n",
+        total,
+        available / 2,
+        available,
+        available / 16,
+        available / 4,
+        swap_total,
+        swap_total - swap_total / 8,
+        total / 64
+    );
+}
+
+/** Returns the sysfs directory of the network interface, the first one is
+    the loopback device which sm ignores. */
+static char *
+InterfaceDir(unsigned i) {
+    if (i == 0) {
+        return Format("%s/class/net/lo", gen_sys_dir);
+    }
+    return Format("%s/class/net/eth%u", gen_sys_dir, i - 1);
+}
+
+static void
+WriteNetwork() {
+    for (unsigned i = 0; i <= gen_options.interface_count; ++i) {
+        char *base = InterfaceDir(i);
+        char *dir = Format("%s/statistics", base);
+        ReplaceFileF(dir, "rx_bytes", "%lu\n", gen_rx_bytes[i]);
+        ReplaceFileF(dir, "tx_bytes", "%lu\n", gen_tx_bytes[i]);
+        free(dir);
+        free(base);
+    }
+}
+
+static void
+WriteThermal() {
+    for (unsigned i = 0; i < gen_options.zone_count; ++i) {
+        char *dir = Format("%s/class/thermal/thermal_zone%u", gen_sys_dir, i);
+        ReplaceFileF(dir, "temp", "%lu\n", 40000 + RandomBelow(30000));
+        free(dir);
+    }
+}
+
+static void
+CreateDirectories() {
+    MakeDir(gen_options.root);
+    // Process directories from an earlier run would be mixed into the tree.
+    if (mkdir(gen_proc_dir, 0755) != 0) {
+        DieErrno("mkdir", gen_proc_dir);
+    }
+    MakeDir(gen_sys_dir);
+    char *path = Format("%s/class", gen_sys_dir);
+    MakeDir(path);
+    free(path);
+    path = Format("%s/class/net", gen_sys_dir);
+    MakeDir(path);
+    free(path);
+    for (unsigned i = 0; i <= gen_options.interface_count; ++i) {
+        char *base = InterfaceDir(i);
+        MakeDir(base);
+        path = Format("%s/statistics", base);
+        MakeDir(path);
+        free(path);
+        free(base);
+    }
+    path = Format("%s/class/thermal", gen_sys_dir);
+    MakeDir(path);
+    free(path);
+    for (unsigned i = 0; i < gen_options.zone_count; ++i) {
+        char *dir = Format("%s/class/thermal/thermal_zone%u", gen_sys_dir, i);
+        MakeDir(dir);
+        ReplaceFileF(dir, "type", "%s\n", i == 0 ? "x86_pkg_temp" : "acpitz");
+        free(dir);
+    }
+}
+
+static void
+CreateProcesses() {
+    gen_next_pid = 1;
+    for (unsigned slot = 0; slot < gen_options.process_count; ++slot) {
+        gen_procs[slot].parent = ParentSlot(slot);
+        gen_procs[slot].children = 0;
+        if (slot) {
+            ++gen_procs[gen_procs[slot].parent].children;
+        }
+        SpawnProcess(slot);
+    }
+}
+
+/** Replaces `churn` leaf processes by new ones with the same parent, leaves
+    are used so there is never a process whose parent has exited. */
+static void
+Churn() {
+    const unsigned count = gen_options.process_count;
+    for (unsigned i = 0; i < gen_options.churn; ++i) {
+        unsigned slot = 1 + RandomBelow(count - 1);
+        for (unsigned tries = 0; tries < count; ++tries) {
+            if (gen_procs[slot].children == 0) {
+                break;
+            }
+            slot = 1 + slot % (count - 1);
+        }
+        if (gen_procs[slot].children != 0) {
+            return;
+        }
+        RemoveProcess(slot);
+        SpawnProcess(slot);
+    }
+}
+
+static void
+Step() {
+    const unsigned long jiffies = gen_options.interval_ms * USER_HZ / 1000;
+    gen_ticks += jiffies;
+    for (unsigned i = 0; i < gen_options.cpu_count; ++i) {
+        const unsigned long busy = RandomBelow(jiffies + 1);
+        const unsigned long system = busy / 4;
+        gen_cpus[i].user += busy - system;
+        gen_cpus[i].system += system;
+        gen_cpus[i].idle += jiffies - busy;
+    }
+    for (unsigned i = 0; i < gen_options.process_count; ++i) {
+        if (RandomBelow(100) >= gen_options.active_percent) {
+            continue;
+        }
+        Process *p = &gen_procs[i];
+        p->utime += RandomBelow(jiffies + 1);
+        p->stime += RandomBelow(jiffies / 4 + 1);
+        char *dir = Format("%s/%d", gen_proc_dir, p->pid);
+        WriteStat(dir, p);
+        free(dir);
+    }
+    Churn();
+    const unsigned long total = gen_options.memory_mib * 1024;
+    gen_memory_used = total / 4 + RandomBelow(total / 2);
+    for (unsigned i = 1; i <= gen_options.interface_count; ++i) {
+        gen_rx_bytes[i] += RandomBelow(1 << 20);
+        gen_tx_bytes[i] += RandomBelow(1 << 18);
+    }
+    WriteProcStat();
+    WriteMeminfo();
+    WriteNetwork();
+    WriteThermal();
+}
+
+static void
+Usage(FILE *stream) {
+    // clang-format off
+    fputs("Usage: procfs_gen [OPTION...] DIR\n", stream);
+    fputs("Writes a fake procfs to DIR/proc and sysfs to DIR/sys.\n", stream);
+    fputs("Options:\n", stream);
+    fputs("  -n count   Number of processes (default 1000)\n", stream);
+    fputs("  -s shape   Process tree shape: flat, deep, balanced or random (default random)\n", stream);
+    fputs("  -d depth   Length of the process chains for the deep shape (default 100)\n", stream);
+    fputs("  -w fanout  Children per process for the balanced shape (default 8)\n", stream);
+    fputs("  -c churn   Processes that exit and get replaced each step (default 0)\n", stream);
+    fputs("  -a percent Percentage of processes using CPU time each step (default 10)\n", stream);
+    fputs("  -C cpus    Number of CPUs (default 8)\n", stream);
+    fputs("  -N count   Number of network interfaces (default 2)\n", stream);
+    fputs("  -z count   Number of thermal zones (default 2)\n", stream);
+    fputs("  -m MiB     Total memory (default 16384)\n", stream);
+    fputs("  -k steps   Number of updates after writing the tree, -1 runs until killed (default 0)\n", stream);
+    fputs("  -i millis  Time between updates (default 1000)\n", stream);
+    fputs("  -S seed    Random seed (default 1)\n", stream);
+    fputs("  -h         Show help message\n", stream);
+    // clang-format on
+}
+
+static Shape
+ParseShape(const char *s) {
+    static const char *names[] = {"flat", "deep", "balanced", "random"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        if (strcmp(s, names[i]) == 0) {
+            return (Shape)i;
+        }
+    }
+    Die("invalid shape: %s", s);
+    return SHAPE_RANDOM;
+}
+
+static void
+ParseArgs(int argc, char *const *argv) {
+    int opt;
+    gen_options = (Options){
+        .process_count = 1000,
+        .shape = SHAPE_RANDOM,
+        .depth = 100,
+        .fanout = 8,
+        .churn = 0,
+        .active_percent = 10,
+        .cpu_count = 8,
+        .interface_count = 2,
+        .zone_count = 2,
+        .memory_mib = 16384,
+        .steps = 0,
+        .interval_ms = 1000,
+        .seed = 1,
+        .root = NULL,
+    };
+    while ((opt = getopt(argc, argv, "n:s:d:w:c:a:C:N:z:m:k:i:S:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            gen_options.process_count = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            gen_options.shape = ParseShape(optarg);
+            break;
+        case 'd':
+            gen_options.depth = strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            gen_options.fanout = strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            gen_options.churn = strtoul(optarg, NULL, 10);
+            break;
+        case 'a':
+            gen_options.active_percent = strtoul(optarg, NULL, 10);
+            break;
+        case 'C':
+            gen_options.cpu_count = strtoul(optarg, NULL, 10);
+            break;
+        case 'N':
+            gen_options.interface_count = strtoul(optarg, NULL, 10);
+            break;
+        case 'z':
+            gen_options.zone_count = strtoul(optarg, NULL, 10);
+            break;
+        case 'm':
+            gen_options.memory_mib = strtoul(optarg, NULL, 10);
+            break;
+        case 'k':
+            gen_options.steps = strtol(optarg, NULL, 10);
+            break;
+        case 'i':
+            gen_options.interval_ms = strtoul(optarg, NULL, 10);
+            break;
+        case 'S':
+            gen_options.seed = strtoull(optarg, NULL, 10);
+            break;
+        case 'h':
+            Usage(stdout);
+            exit(0);
+        default:
+            Usage(stderr);
+            exit(1);
+        }
+    }
+    if (optind != argc - 1) {
+        Usage(stderr);
+        exit(1);
+    }
+    gen_options.root = argv[optind];
+    if (gen_options.process_count < 2 || gen_options.process_count >= PID_MAX) {
+        Die("process count must be in 2~%d", PID_MAX - 1);
+    }
+    if (gen_options.cpu_count == 0 || gen_options.depth == 0
+        || gen_options.fanout == 0) {
+        Die("CPU count, depth and fanout must be positive");
+    }
+}
+
+int
+main(int argc, char *const *argv) {
+    ParseArgs(argc, argv);
+    gen_random_state = gen_options.seed | 1;
+    gen_proc_dir = Format("%s/proc", gen_options.root);
+    gen_sys_dir = Format("%s/sys", gen_options.root);
+    gen_procs = calloc(gen_options.process_count, sizeof(Process));
+    gen_used_pids = calloc(PID_MAX / 8, 1);
+    gen_cpus = calloc(gen_options.cpu_count, sizeof(Cpu_Times));
+    gen_rx_bytes = calloc(gen_options.interface_count + 1, sizeof(long));
+    gen_tx_bytes = calloc(gen_options.interface_count + 1, sizeof(long));
+    gen_memory_used = gen_options.memory_mib * 1024 / 2;
+
+    CreateDirectories();
+    CreateProcesses();
+    WriteProcStat();
+    WriteMeminfo();
+    WriteNetwork();
+    WriteThermal();
+
+    const struct timespec interval = {
+        .tv_sec = gen_options.interval_ms / 1000,
+        .tv_nsec = (gen_options.interval_ms % 1000) * 1000000L,
+    };
+    for (long step = 0; gen_options.steps < 0 || step < gen_options.steps;
+         ++step) {
+        nanosleep(&interval, NULL);
+        Step();
+    }
+    return 0;
+}
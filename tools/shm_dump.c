@@ -0,0 +1,101 @@
+// Prints the snapshot published by `sm --shm=NAME`, as an example of reading
+// it without any system calls once the object is mapped:
+//
+//   make shm_dump
+//   ./sm --shm=sm &
+//   ./shm_dump sm
+//
+// The snapshot is copied under the seqlock described in src/shm_layout.h and
+// printed from the copy.
+
+#define _GNU_SOURCE
+#include "../src/shm_layout.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Copies the whole region, retrying while the writer is busy. */
+static void
+copy_snapshot(const uint8_t *map, uint8_t *copy, size_t size) {
+    const Shm_Header *h = (const Shm_Header *)map;
+    uint32_t sequence;
+    do {
+        while ((sequence = __atomic_load_n(&h->sequence, __ATOMIC_ACQUIRE))
+               & 1) {
+        }
+        memcpy(copy, map, size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&h->sequence, __ATOMIC_RELAXED) != sequence);
+}
+
+static double
+latest(const Shm_Header *h, const double *rings, unsigned ring) {
+    return rings[ring * h->ring_size + h->ring_head];
+}
+
+int
+main(int argc, char **argv) {
+    char name[256];
+    struct stat st;
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s NAME\n", argv[0]);
+        return 1;
+    }
+    snprintf(name, sizeof(name), "%s%s", argv[1][0] == '/' ? "" : "/", argv[1]);
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(name);
+        return 1;
+    }
+    const size_t size = st.st_size;
+    const uint8_t *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED || size < sizeof(Shm_Header)
+        || memcmp(map, SHM_MAGIC, SHM_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "%s: not an sm snapshot\n", name);
+        return 1;
+    }
+
+    uint8_t *copy = malloc(size);
+    copy_snapshot(map, copy, size);
+    const Shm_Header *h = (const Shm_Header *)copy;
+    const double *rings = (const double *)(copy + h->ring_offset);
+    const Shm_Proc *procs = (const Shm_Proc *)(copy + h->proc_offset);
+    const char *strings = (const char *)(copy + h->string_offset);
+    if (h->ring_filled == 0) {
+        puts("no samples yet");
+        return 0;
+    }
+
+    printf("time      %.3f\n", h->time / 1e9);
+    printf("cpu       %.1f%%", latest(h, rings, SHM_RING_CPU_AVERAGE) * 100);
+    for (unsigned i = 0; i < h->cpu_count; ++i) {
+        printf(" %.1f%%", latest(h, rings, SHM_RING_CPU + i) * 100);
+    }
+    printf("\nmemory    %.1f%% of %lu bytes\n",
+           latest(h, rings, SHM_RING_MEMORY) * 100,
+           (unsigned long)h->memory_total);
+    printf("swap      %.1f%% of %lu bytes\n",
+           latest(h, rings, SHM_RING_SWAP) * 100,
+           (unsigned long)h->swap_total);
+    printf("network   %.0f B/s received, %.0f B/s transmitted\n",
+           latest(h, rings, SHM_RING_RECEIVE),
+           latest(h, rings, SHM_RING_TRANSMIT));
+    printf("history   %u samples\n", h->ring_filled);
+    printf("\n%8s %8s %12s %12s  COMMAND\n", "PID", "PPID", "CPU TICKS", "RSS");
+    for (uint32_t i = 0; i < h->proc_count; ++i) {
+        printf("%8d %8d %12lu %12lu  %.*s\n",
+               procs[i].pid,
+               procs[i].parent,
+               (unsigned long)procs[i].cpu_time,
+               (unsigned long)procs[i].memory,
+               (int)procs[i].command_length,
+               strings + procs[i].command_offset);
+    }
+    free(copy);
+    return 0;
+}